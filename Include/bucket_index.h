@@ -0,0 +1,51 @@
+#include <cstddef>
+#include <cstdint>
+
+#pragma once
+
+#include "hash.h"
+
+/// @brief bucket index policy: power of two bucket counts, indexed with a
+/// mask
+/// @remarks the mask only looks at the low bits of the hash, so the hash is
+/// run through a finalizer first to fold the high bits into them
+struct pow2_buckets {
+    /// @brief rounds a bucket count up to one this policy can index
+    /// @returns size_t the next power of two
+    static size_t bucket_count(size_t requested);
+
+    /// @param bucket_count a count returned by bucket_count
+    explicit pow2_buckets(size_t bucket_count);
+
+    /// @brief picks the bucket for a hash
+    size_t operator()(hash_t hval) const;
+
+    /// @brief mixes the high bits of a hash into the low ones
+    static hash_t finalize(hash_t hval);
+
+  private:
+    size_t _mask;
+};
+
+/// @brief bucket index policy: prime bucket counts, indexed with a modulus
+/// @remarks every bit of the hash counts towards the bucket, which is the
+/// safer choice for weak hashes. the modulus is computed from a reciprocal
+/// worked out once per bucket count, so lookups still avoid a division.
+struct prime_buckets {
+    /// @brief rounds a bucket count up to one this policy can index
+    /// @returns size_t the next prime from a table of roughly doubling primes
+    /// @throws std::length_error past the largest prime below 2^32
+    static size_t bucket_count(size_t requested);
+
+    /// @param bucket_count a count returned by bucket_count
+    explicit prime_buckets(size_t bucket_count);
+
+    /// @brief picks the bucket for a hash
+    size_t operator()(hash_t hval) const;
+
+  private:
+    uint32_t _divisor;
+    uint64_t _reciprocal;
+};
+
+#include "bucket_index.inc"
@@ -0,0 +1,284 @@
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+#pragma once
+
+#include "epoch.h"
+#include "hashmap.h"
+
+const size_t DEFAULT_CONCURRENT_SHARD_COUNT = 64;
+
+/// @brief map that many threads may use at once, split into shards that each
+/// hold a Hashmap behind their own lock
+/// @remarks a key is hashed once: the shard is picked from the high bits of
+/// the hash and the shard's map buckets it with the low bits, so the two do
+/// not correlate. readers of a shard share its lock, writers take it alone, and
+/// threads working on different shards never touch the same cache line.
+/// the template parameters are those of the Hashmap of every shard.
+template <typename TKey, typename TValue, typename Hash = hasher<TKey>,
+          typename KeyEqual = std::equal_to<>,
+          typename Storage = chained_storage<>,
+          typename Allocator = std::allocator<std::pair<const TKey, TValue>>>
+class ConcurrentHashmap {
+    using Map = Hashmap<TKey, TValue, Hash, KeyEqual, Storage, Allocator>;
+
+    /// padded to a cache line so that the locks of two shards never share
+    /// one
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        mutable std::shared_mutex mutex;
+        Map map;
+    };
+
+  public:
+    /// @param shard_count how many shards to split the map into, rounded up
+    /// to a power of two. more shards than threads keeps them from waiting
+    /// on each other.
+    explicit ConcurrentHashmap(
+        size_t shard_count = DEFAULT_CONCURRENT_SHARD_COUNT);
+
+    ConcurrentHashmap(const ConcurrentHashmap &other) = delete;
+    ConcurrentHashmap &operator=(const ConcurrentHashmap &other) = delete;
+
+    /// @brief adds the key value pair, if the key is not there yet
+    /// @returns bool if the item was added
+    bool add(const TKey &key, const TValue &value);
+
+    /// @brief adds the key value pair, replacing the value if the key is
+    /// already there
+    void put(const TKey &key, const TValue &value);
+
+    /// @brief gets the value attached to the key
+    /// @returns TValue a copy of the value, a reference would outlive the
+    /// lock that keeps it alive
+    /// @throws key_not_found if the key was not found
+    TValue get(const TKey &key) const;
+
+    /// @brief removes the item at the key
+    /// @returns TValue the value of the item that was removed
+    /// @throws key_not_found if the key was not found
+    TValue remove(const TKey &key);
+
+    /// @brief checks if there is an item with that key
+    bool contains(const TKey &key) const;
+
+    /// @brief returns the number of items in the map
+    /// @remarks the shards are counted one after the other, so with writers
+    /// running the sum is only a rough figure
+    size_t size() const;
+
+    /// @brief removes every item, one shard at a time
+    void clear();
+
+    /// @brief returns how many shards the map is split into
+    size_t shard_count() const;
+
+  private:
+    std::unique_ptr<Shard[]> _shards;
+    size_t _shard_count;
+    /// how far a hash is shifted right to leave the shard bits
+    unsigned _shard_shift;
+    [[no_unique_address]] Hash _hash;
+
+    Shard &shard_for(hash_t hval) const;
+};
+
+/// @brief chained map whose readers take no lock at all, for workloads that
+/// are nearly all lookups
+/// @remarks readers walk the buckets with acquire loads under an EpochGuard.
+/// writers take one mutex, publish new nodes with release stores and never
+/// change a node a reader may see: put links in a new node in place of the
+/// old one, and growing copies the nodes into the new buckets. what they
+/// unlink is retired to the EpochDomain, which frees it once no reader can
+/// still hold it. writes are serialized, a write heavy load is better off
+/// with ConcurrentHashmap.
+///
+/// growing does not copy everything at once: the old buckets stay in use
+/// and every write after it copies a few of them over, as does migrate,
+/// which helper threads may call to move the rest along sooner.
+template <typename TKey, typename TValue, typename Hash = hasher<TKey>,
+          typename KeyEqual = std::equal_to<>>
+class LockFreeReadHashmap {
+    struct Node {
+        const TKey key;
+        const TValue data;
+        std::atomic<Node *> next;
+
+        Node(const TKey &key, const TValue &data, Node *next);
+    };
+
+    /// @brief the buckets, swapped out whole by growing or a clear
+    /// @remarks owns the nodes in its chains, once swapped out nothing links
+    /// them anywhere else
+    struct Table {
+        explicit Table(size_t bucket_count);
+
+        Table(const Table &other) = delete;
+        Table &operator=(const Table &other) = delete;
+
+        ~Table();
+
+        size_t bucket_count;
+        pow2_buckets index;
+        std::unique_ptr<std::atomic<Node *>[]> buckets;
+        /// the table this one grew from while its items are still being
+        /// copied over, nullptr after
+        std::atomic<Table *> old;
+        /// buckets of old below this one have been copied, the rest still
+        /// hold their items there
+        std::atomic<size_t> migrated;
+    };
+
+  public:
+    explicit LockFreeReadHashmap(
+        size_t bucket_count = DEFAULT_HASHMAP_BUCKET_COUNT);
+
+    LockFreeReadHashmap(const LockFreeReadHashmap &other) = delete;
+    LockFreeReadHashmap &operator=(const LockFreeReadHashmap &other) = delete;
+
+    /// @remarks no reader may still be using the map
+    ~LockFreeReadHashmap();
+
+    /// @brief adds the key value pair, if the key is not there yet
+    /// @returns bool if the item was added
+    bool add(const TKey &key, const TValue &value);
+
+    /// @brief adds the key value pair, replacing the item if the key is
+    /// already there
+    void put(const TKey &key, const TValue &value);
+
+    /// @brief gets the value attached to the key, without locking
+    /// @returns TValue a copy of the value
+    /// @throws key_not_found if the key was not found
+    TValue get(const TKey &key) const;
+
+    /// @brief removes the item at the key
+    /// @returns TValue the value of the item that was removed
+    /// @throws key_not_found if the key was not found
+    TValue remove(const TKey &key);
+
+    /// @brief checks if there is an item with that key, without locking
+    bool contains(const TKey &key) const;
+
+    /// @brief returns the number of items in the map
+    size_t size() const;
+
+    /// @brief removes every item
+    void clear();
+
+    /// @brief returns how many buckets the map has
+    size_t bucket_count() const;
+
+    /// @brief copies up to count buckets that a grow left behind into the
+    /// new buckets
+    /// @returns bool if there are buckets left to copy
+    /// @remarks writes do this a few buckets at a time anyway, a helper
+    /// thread calling it finishes the grow sooner
+    bool migrate(size_t count = HASHMAP_MIGRATE_BUCKETS);
+
+  private:
+    std::atomic<Table *> _table;
+    std::atomic<size_t> _item_count;
+    std::mutex _write_mutex;
+    [[no_unique_address]] Hash _hash;
+    [[no_unique_address]] KeyEqual _equal;
+
+    const Node *find_node(const TKey &key) const;
+    static std::atomic<Node *> *bucket_for(const Table *table, hash_t hval);
+    std::atomic<Node *> *find_link(Table *table, hash_t hval,
+                                   const TKey &key);
+    void link_new(Table *table, hash_t hval, const TKey &key,
+                  const TValue &value);
+    void grow(Table *table);
+    bool migrate_buckets(Table *table, size_t count);
+};
+
+/// @brief map for data that is read all the time and replaced now and then,
+/// published as read only versions in the manner of read-copy-update
+/// @remarks readers load the current version with an acquire load under an
+/// EpochGuard and take no lock. writers build the next version beside it,
+/// from scratch with publish or from a copy of the current one with update,
+/// and swap it in with a release store. the version it replaced is retired
+/// to the EpochDomain and freed once no snapshot of it is left. every write
+/// copies the whole map, so this pays off when writes are rare and batched.
+/// the template parameters are those of the Hashmap of every version.
+template <typename TKey, typename TValue, typename Hash = hasher<TKey>,
+          typename KeyEqual = std::equal_to<>,
+          typename Storage = chained_storage<>,
+          typename Allocator = std::allocator<std::pair<const TKey, TValue>>>
+class SnapshotHashmap {
+  public:
+    using Map = Hashmap<TKey, TValue, Hash, KeyEqual, Storage, Allocator>;
+
+    /// @brief one version of the map, which stays as it is and stays alive
+    /// for as long as the snapshot does
+    /// @remarks keeps the calling thread pinned, so it is meant to be held
+    /// for a batch of lookups, not stored: while it lives, nothing retired
+    /// anywhere in the process can be freed
+    class Snapshot {
+      public:
+        Snapshot(const Snapshot &other) = delete;
+        Snapshot &operator=(const Snapshot &other) = delete;
+
+        const Map &operator*() const;
+        const Map *operator->() const;
+
+      private:
+        friend class SnapshotHashmap;
+
+        explicit Snapshot(const std::atomic<Map *> &current);
+
+        /// declared first, the pin has to come before the load
+        EpochGuard _guard;
+        const Map *_map;
+    };
+
+    /// @brief starts out with an empty map
+    SnapshotHashmap();
+
+    /// @brief starts out with map as the first version
+    explicit SnapshotHashmap(Map map);
+
+    SnapshotHashmap(const SnapshotHashmap &other) = delete;
+    SnapshotHashmap &operator=(const SnapshotHashmap &other) = delete;
+
+    /// @remarks no snapshot of the current version may still be alive
+    ~SnapshotHashmap();
+
+    /// @brief takes a snapshot of the current version, without locking
+    Snapshot snapshot() const;
+
+    /// @brief gets the value attached to the key in the current version
+    /// @returns TValue a copy of the value, the version may be retired
+    /// right after
+    /// @throws key_not_found if the key was not found
+    TValue get(const TKey &key) const;
+
+    /// @brief checks if the current version has an item with that key
+    bool contains(const TKey &key) const;
+
+    /// @brief returns the number of items in the current version
+    size_t size() const;
+
+    /// @brief makes map the current version
+    void publish(Map map);
+
+    /// @brief copies the current version, lets change edit the copy and
+    /// publishes it
+    /// @param change called as change(Map &) on the copy
+    /// @remarks writers are serialized, so no update is lost to another.
+    /// if change throws, the copy is dropped and nothing is published.
+    template <typename Change> void update(Change &&change);
+
+  private:
+    std::atomic<Map *> _current;
+    std::mutex _write_mutex;
+
+    void swap_in(Map *next);
+};
+
+#include "concurrent_hashmap.inc"
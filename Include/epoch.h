@@ -0,0 +1,99 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#pragma once
+
+/// size of a cache line, things written by different threads are padded to
+/// it so that they never share one
+const size_t CACHE_LINE_SIZE = 64;
+/// how many retired objects pile up before a retire tries to free some
+const size_t EPOCH_COLLECT_THRESHOLD = 128;
+
+/// @brief epoch based reclamation: frees objects that were unlinked from a
+/// shared structure once no reader can still be looking at them
+/// @remarks a reader pins the current epoch for as long as it holds
+/// pointers into the structure, see EpochGuard. the epoch only moves on
+/// once every pinned reader has seen it, so an object retired in epoch e is
+/// unreachable for every reader by the time the epoch reaches e + 2. there
+/// is one domain for the whole process, shared by every map.
+class EpochDomain {
+  public:
+    /// @brief the domain of the process
+    static EpochDomain &instance();
+
+    EpochDomain(const EpochDomain &other) = delete;
+    EpochDomain &operator=(const EpochDomain &other) = delete;
+
+    /// @brief frees every object still retired
+    ~EpochDomain();
+
+    /// @brief marks the calling thread as reading, pins may nest
+    void pin();
+
+    /// @brief undoes one pin, the thread stops reading with the last one
+    void unpin();
+
+    /// @brief hands an object over to be deleted once no reader can see it
+    /// @remarks the object has to be unreachable for new readers already
+    template <typename T> void retire(T *ptr);
+
+    /// @brief moves the epoch on if every reader has seen it, then frees
+    /// what is old enough
+    /// @remarks it takes up to three calls with no reader pinned to free
+    /// everything retired before the first one
+    void collect();
+
+    /// @brief returns the current epoch
+    uint64_t epoch() const;
+
+    /// @brief returns how many objects wait to be freed
+    size_t retired_count() const;
+
+  private:
+    /// epoch of a record whose thread is not reading
+    static const uint64_t IDLE = UINT64_MAX;
+
+    /// @brief what a thread reads under, reused once the thread is gone
+    struct alignas(CACHE_LINE_SIZE) Record {
+        std::atomic<uint64_t> epoch{IDLE};
+        std::atomic<bool> in_use{false};
+        /// only touched by the thread that owns the record
+        size_t depth = 0;
+        Record *next = nullptr;
+    };
+
+    struct Retired {
+        void *ptr;
+        void (*destroy)(void *);
+        uint64_t epoch;
+    };
+
+    EpochDomain();
+
+    Record *thread_record();
+    Record *claim_record();
+    void add_retired(void *ptr, void (*destroy)(void *));
+    bool try_advance();
+    void free_retired();
+
+    std::atomic<uint64_t> _epoch;
+    std::atomic<Record *> _records;
+    mutable std::mutex _retire_mutex;
+    std::vector<Retired> _retired;
+};
+
+/// @brief pins the epoch for as long as it lives, see EpochDomain
+class EpochGuard {
+  public:
+    EpochGuard();
+
+    EpochGuard(const EpochGuard &other) = delete;
+    EpochGuard &operator=(const EpochGuard &other) = delete;
+
+    ~EpochGuard();
+};
+
+#include "epoch.inc"
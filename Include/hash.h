@@ -1,94 +1,185 @@
-#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#pragma once
+
 typedef unsigned long long hash_t;
 
-hash_t hash_integral(hash_t integral);
-hash_t hash_string(const char* str);
+/// @brief mixes an integer into a well spread 64 bit hash
+constexpr hash_t hash_integral(hash_t integral);
+
+/// @brief hashes a run of bytes into a full 64 bit value
+/// @param data the first byte, may be null when length is 0
+/// @param length how many bytes to hash, embedded nulls count like any other
+/// @param seed changes every hash, for when two tables must not collide alike
+/// @remarks wyhash style: 16 bytes are mixed per multiply, inputs longer
+/// than 48 bytes run three of those lanes side by side
+inline hash_t hash_bytes(const void* data, size_t length, hash_t seed = 0);
 
-struct no_hash: public std::logic_error {
-    no_hash(const char* message):
-        std::logic_error(message) 
-    {}
+/// @brief hashes a null terminated string, see hash_bytes
+inline hash_t hash_string(const char* str);
 
-    static void throw_for_type(const std::type_info& type) {
-        std::string message = std::string("no hash for type ") + type.name();
-        throw no_hash(message.c_str());
+/// @brief whether std::hash<T> is enabled for T
+template <typename T, typename = void>
+struct has_std_hash : std::false_type {};
+
+template <typename T>
+struct has_std_hash<
+    T, std::void_t<decltype(std::hash<T>()(std::declval<const T&>()))>>
+    : std::true_type {};
+
+/// @brief the default Hash of a Hashmap
+/// @remarks integers, enums and strings are hashed here, any other type
+/// falls back to std::hash, with its result run through hash_integral since
+/// std::hash is often the identity. specialize this, or pass a Hash to
+/// Hashmap, to hash your own types.
+template <typename T, typename = void>
+struct hasher {
+    static_assert(has_std_hash<T>::value,
+                  "no hash for this key type: specialize hasher or std::hash, "
+                  "or give Hashmap a Hash");
+
+    hash_t operator()(const T& obj) const {
+        return hash_integral(std::hash<T>()(obj));
     }
 };
 
 template <typename T>
-hash_t hash(T obj) {
-    no_hash::throw_for_type(typeid(T));
-    return 0; //for linter
-}
+struct hasher<T, std::enable_if_t<std::is_integral<T>::value ||
+                                  std::is_enum<T>::value>> {
+    constexpr hash_t operator()(T obj) const noexcept {
+        return hash_integral(static_cast<hash_t>(obj));
+    }
+};
 
+// the string hashers are transparent: a std::string_view or a C string
+// hashes the same as the std::string holding those characters
 template <>
-hash_t hash<char>(char obj) {
-    return hash_integral(obj);
-}
+struct hasher<std::string> {
+    using is_transparent = void;
 
-template <>
-hash_t hash<unsigned char>(unsigned char obj) {
-    return hash_integral(obj);
-}
+    hash_t operator()(std::string_view obj) const noexcept {
+        return hash_bytes(obj.data(), obj.size());
+    }
+};
 
 template <>
-hash_t hash<int>(int obj) {
-    return hash_integral(obj);
-}
+struct hasher<std::string_view> : hasher<std::string> {};
 
 template <>
-hash_t hash<unsigned int>(unsigned int obj) {
-    return hash_integral(obj);
-}
+struct hasher<const char*> {
+    hash_t operator()(const char* obj) const noexcept {
+        return hash_string(obj);
+    }
+};
 
 template <>
-hash_t hash<short>(short obj) {
-    return hash_integral(obj);
-}
+struct hasher<char*> : hasher<const char*> {};
 
-template <>
-hash_t hash<unsigned short>(unsigned short obj) {
-    return hash_integral(obj);
+/// @brief hashes obj with the default hasher for its type
+/// @remarks fails to compile for a type with no hash
+template <typename T>
+constexpr hash_t hash(const T& obj) {
+    return hasher<std::decay_t<T>>()(obj);
 }
 
-template <>
-hash_t hash<long long>(long long obj) {
-    return hash_integral(obj);
+constexpr hash_t hash_integral(hash_t integral)
+{
+    integral = (integral ^ (integral >> 30)) * 0xbf58476d1ce4e5b9UL;
+    integral = (integral ^ (integral >> 27)) * 0x94d049bb133111ebUL;
+    integral = integral ^ (integral >> 31);
+    return integral;
 }
 
-template <>
-hash_t hash<hash_t>(hash_t obj) {
-    return hash_integral(obj);
-}
+/// multipliers for hash_bytes, odd with half their bits set
+const hash_t HASH_BYTES_SECRET[4] = {
+    0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL,
+    0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL};
 
-template <>
-hash_t hash<const char*>(const char* obj) {
-    return hash_string(obj);
+/// @brief multiplies to 128 bits and folds the halves together
+inline hash_t hash_mum(hash_t a, hash_t b)
+{
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return static_cast<hash_t>(product) ^ static_cast<hash_t>(product >> 64);
 }
 
-template <>
-hash_t hash<const std::string&>(const std::string& obj) {
-    return hash_string(obj.c_str());
+inline hash_t hash_read64(const unsigned char* p)
+{
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
 }
 
-hash_t hash_integral(hash_t integral)
+inline hash_t hash_read32(const unsigned char* p)
 {
-    integral = (integral ^ (integral >> 30)) * 0xbf58476d1ce4e5b9UL;
-    integral = (integral ^ (integral >> 27)) * 0x94d049bb133111ebUL;
-    integral = integral ^ (integral >> 31);
-    return integral;
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
 }
 
-hash_t hash_string(const char* str)
+inline hash_t hash_bytes(const void* data, size_t length, hash_t seed)
 {
-    hash_t hashVal = 0;
-    while(*str != '\0')
-    {
-        hashVal = (hashVal << 4) + *(str++);
-        unsigned long g = hashVal & 0xF0000000L;
-        if(g != 0) hashVal ^= g >> 24;
-        hashVal &= ~g;
-        str += 1;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const hash_t* secret = HASH_BYTES_SECRET;
+    seed ^= hash_mum(seed ^ secret[0], secret[1]);
+
+    hash_t a, b;
+    if (length <= 16) {
+        if (length >= 4) {
+            // two overlapping reads from each end cover 4 to 16 bytes
+            size_t shift = (length >> 3) << 2;
+            a = (hash_read32(p) << 32) | hash_read32(p + shift);
+            b = (hash_read32(p + length - 4) << 32) |
+                hash_read32(p + length - 4 - shift);
+        } else if (length > 0) {
+            a = (static_cast<hash_t>(p[0]) << 16) |
+                (static_cast<hash_t>(p[length >> 1]) << 8) | p[length - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t left = length;
+        if (left > 48) {
+            hash_t lane1 = seed, lane2 = seed;
+            do {
+                seed = hash_mum(hash_read64(p) ^ secret[1],
+                                hash_read64(p + 8) ^ seed);
+                lane1 = hash_mum(hash_read64(p + 16) ^ secret[2],
+                                 hash_read64(p + 24) ^ lane1);
+                lane2 = hash_mum(hash_read64(p + 32) ^ secret[3],
+                                 hash_read64(p + 40) ^ lane2);
+                p += 48;
+                left -= 48;
+            } while (left > 48);
+            seed ^= lane1 ^ lane2;
+        }
+        while (left > 16) {
+            seed = hash_mum(hash_read64(p) ^ secret[1],
+                            hash_read64(p + 8) ^ seed);
+            p += 16;
+            left -= 16;
+        }
+        // the last 16 bytes, overlapping what came before if need be
+        a = hash_read64(p + left - 16);
+        b = hash_read64(p + left - 8);
     }
-    return hashVal;
+
+    a ^= secret[1];
+    b ^= seed;
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    a = static_cast<hash_t>(product);
+    b = static_cast<hash_t>(product >> 64);
+    return hash_mum(a ^ secret[0] ^ length, b ^ secret[1]);
+}
+
+inline hash_t hash_string(const char* str)
+{
+    return hash_bytes(str, std::strlen(str));
 }
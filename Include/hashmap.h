@@ -1,14 +1,84 @@
+#include "bucket_index.h"
 #include "hash.h"
+#include "map_iterator.h"
+#include "node_pool.h"
 #include <cstddef>
 #include <functional>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <ranges>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #pragma once
 
 const size_t DEFAULT_HASHMAP_BUCKET_COUNT = 16;
+const float DEFAULT_HASHMAP_MAX_LOAD_FACTOR = 1.0f;
+/// how many old buckets a chained map empties into the new ones on each
+/// change while it grows
+const size_t HASHMAP_MIGRATE_BUCKETS = 8;
+
+/// @brief storage policy which keeps every item in its own node, chained
+/// together per bucket
+/// @tparam BucketIndex how a hash is turned into a bucket, pow2_buckets or
+/// prime_buckets
+/// @tparam CacheHash whether every node keeps the full hash of its key, so
+/// resizes never hash a key again and chain walks only compare the keys of
+/// nodes whose hash matches. worth its 8 bytes a node for keys that are slow
+/// to hash or compare, such as long strings.
+template <typename BucketIndex = pow2_buckets, bool CacheHash = false>
+struct chained_storage {
+    using bucket_index = BucketIndex;
+    static constexpr bool cache_hash = CacheHash;
+};
+
+template <typename Storage> struct is_chained_storage : std::false_type {};
+
+template <typename BucketIndex, bool CacheHash>
+struct is_chained_storage<chained_storage<BucketIndex, CacheHash>>
+    : std::true_type {};
+
+/// @brief storage policy which keeps every item inline in one flat array of
+/// slots, using robin hood probing
+struct flat_storage {};
+
+/// @brief storage policy which keeps every item inline in one flat array of
+/// slots, with a control byte per slot that lookups scan a group at a time
+struct swiss_storage {};
+
+template <typename TKey, typename TValue, typename Hash = hasher<TKey>,
+          typename KeyEqual = std::equal_to<>,
+          typename Storage = chained_storage<>,
+          typename Allocator = std::allocator<std::pair<const TKey, TValue>>>
+class Hashmap;
+
+/// @brief whether T declares is_transparent, meaning it takes keys of other
+/// types than the map's own
+template <typename T, typename = void>
+struct is_transparent : std::false_type {};
 
-template <typename TKey, typename TValue> class Hashmap;
+template <typename T>
+struct is_transparent<T, std::void_t<typename T::is_transparent>>
+    : std::true_type {};
+
+/// @brief enables the heterogeneous lookups of a map when both its Hash and
+/// KeyEqual are transparent
+template <typename Hash, typename KeyEqual>
+using if_transparent = std::enable_if_t<
+    is_transparent<Hash>::value && is_transparent<KeyEqual>::value, int>;
+
+/// @brief enables the range constructor of a map only for iterators, so it
+/// never catches a call with two integers
+template <typename It>
+using if_input_iterator = std::enable_if_t<std::input_iterator<It>, int>;
+
+/// @brief adds one item of a bulk insert to map, taking the key and value
+/// from a std::pair or from the Entry a map iterator hands out
+/// @remarks an rvalue pair has its key and value moved in
+template <typename Map, typename Item> void emplace_item(Map &map, Item &&item);
 
 struct key_not_found : public std::logic_error {
     key_not_found(const char *message) : std::logic_error(message) {}
@@ -16,30 +86,177 @@ struct key_not_found : public std::logic_error {
     key_not_found() : std::logic_error("key not found") {}
 };
 
-template <typename TKey, typename TValue>
-std::ostream &operator<<(std::ostream &out, const Hashmap<TKey, TValue> &map);
+template <typename TKey, typename TValue, typename Hash, typename KeyEqual,
+          typename Storage, typename Allocator>
+std::ostream &
+operator<<(std::ostream &out,
+           const Hashmap<TKey, TValue, Hash, KeyEqual, Storage, Allocator>
+               &map);
+
+/// @brief the hash a node keeps of its key, nothing unless its storage
+/// caches hashes
+template <bool Cached> struct node_hash {
+    static constexpr bool cached = false;
+
+    hash_t stored_hash() const { return 0; }
+    void store_hash(hash_t) {}
+    bool hash_differs(hash_t) const { return false; }
+};
+
+template <> struct node_hash<true> {
+    static constexpr bool cached = true;
+    hash_t hval;
 
-template <typename TKey, typename TValue> struct Node {
+    hash_t stored_hash() const { return hval; }
+    void store_hash(hash_t hash) { hval = hash; }
+    bool hash_differs(hash_t hash) const { return hval != hash; }
+};
+
+template <typename TKey, typename TValue, bool CacheHash = false>
+struct Node : node_hash<CacheHash> {
     TKey key;
     TValue data;
-    Node<TKey, TValue> *next;
+    Node *next;
+
+    /// @brief makes the key from key and the value from args
+    template <typename K, typename... Args,
+              typename = std::enable_if_t<
+                  !std::is_same<std::decay_t<K>, Node>::value>>
+    Node(K &&key, Args &&...args);
+};
+
+/// @brief position of a chained map iterator: a node and the bucket it is in
+template <typename TNode> struct ChainedPosition {
+    /// @brief the end position
+    ChainedPosition();
+
+    /// @brief the first node at or after bucket
+    ChainedPosition(TNode **bucket, TNode **end, TNode **rest = nullptr,
+                    TNode **rest_end = nullptr);
+
+    /// @brief node, which is in bucket
+    ChainedPosition(TNode **bucket, TNode **end, TNode *node,
+                    TNode **rest = nullptr, TNode **rest_end = nullptr);
+
+    const auto &key() const;
+    auto &data() const;
+    void advance();
+    bool operator==(const ChainedPosition &other) const;
+
+    TNode **bucket;
+    TNode **end;
+    /// buckets walked once end is reached: those the map still has to
+    /// empty after it grew, nullptr when there are none
+    TNode **rest;
+    TNode **rest_end;
+    /// nullptr at the end
+    TNode *node;
+
+  private:
+    void seek();
+};
+
+/// @brief owns a node taken out of a chained map by extract, until it is
+/// put into another map or dropped
+/// @remarks the node keeps its key and value where they are, so moving an
+/// item between maps of the same type neither allocates nor copies
+template <typename TNode, typename TAlloc> class NodeHandle {
+    using NodeTraits = std::allocator_traits<TAlloc>;
+
+  public:
+    /// @brief an empty handle
+    NodeHandle();
+
+    NodeHandle(NodeHandle &&other);
+
+    NodeHandle &operator=(NodeHandle &&other);
 
-    Node(const TKey &key, const TValue &data);
+    /// @brief destroys the node, if the handle still holds one
+    ~NodeHandle();
+
+    /// @brief checks if the handle holds no node
+    bool empty() const;
+
+    explicit operator bool() const;
+
+    /// @brief the key of the node, which may be changed before the node is
+    /// inserted again
+    auto &key() const;
+
+    /// @brief the value of the node
+    auto &data() const;
+
+  private:
+    template <typename, typename, typename, typename, typename, typename>
+    friend class Hashmap;
+
+    NodeHandle(TNode *node, const TAlloc &alloc);
+
+    void reset();
+
+    TNode *_node;
+    TAlloc _alloc;
 };
 
-template <typename TKey, typename TValue> class Hashmap {
-    using Node_t = Node<TKey, TValue>;
+template <typename TKey, typename TValue, typename Hash, typename KeyEqual,
+          typename Storage, typename Allocator>
+class Hashmap {
+    static_assert(is_chained_storage<Storage>::value,
+                  "unknown storage policy");
+    static_assert(
+        std::is_invocable_r<hash_t, const Hash &, const TKey &>::value,
+        "Hash must be callable with a const TKey&");
+    static_assert(std::is_invocable_r<bool, const KeyEqual &, const TKey &,
+                                      const TKey &>::value,
+                  "KeyEqual must be callable with two const TKey&");
+
+    using Node_t = Node<TKey, TValue, Storage::cache_hash>;
+    using NodeAlloc = typename std::allocator_traits<
+        Allocator>::template rebind_alloc<Node_t>;
+    using NodeTraits = std::allocator_traits<NodeAlloc>;
+    using BucketAlloc = typename std::allocator_traits<
+        Allocator>::template rebind_alloc<Node_t *>;
+    using BucketTraits = std::allocator_traits<BucketAlloc>;
+    using BucketIndex = typename Storage::bucket_index;
 
   public:
+    using node_type = NodeHandle<Node_t, NodeAlloc>;
+    using iterator = MapIterator<ChainedPosition<Node_t>, TKey, TValue, false>;
+    using const_iterator =
+        MapIterator<ChainedPosition<Node_t>, TKey, TValue, true>;
+
     #ifdef DEBUG
-        friend void forceResize(Hashmap<TKey, TValue> &map);
-        friend int getBucketCount(Hashmap<TKey, TValue> &map);
+        template <typename Map> friend void forceResize(Map &map);
+        template <typename Map> friend int getBucketCount(Map &map);
+        template <typename Map> friend size_t getOldBucketCount(Map &map);
     #endif
     /// @brief default constructor
     Hashmap();
 
+    /// @brief makes an empty map which gets its nodes from alloc
+    /// @param alloc the allocator to use, rebound to the node type
+    explicit Hashmap(const Allocator &alloc);
+
+    /// @brief makes an empty map with at least bucket_count buckets
+    /// @remarks the buckets hold bucket_count * max_load_factor() items
+    /// before the map first grows, see reserve for sizing by items instead
+    explicit Hashmap(size_t bucket_count,
+                     const Allocator &alloc = Allocator());
+
+    /// @brief makes a map holding the items from first to last, either
+    /// std::pairs or the entries of another map
+    /// @remarks forward iterators are counted first, so the map is sized
+    /// once. when a key comes up twice, the first item wins.
+    template <typename InputIt, if_input_iterator<InputIt> = 0>
+    Hashmap(InputIt first, InputIt last,
+            size_t bucket_count = DEFAULT_HASHMAP_BUCKET_COUNT,
+            const Allocator &alloc = Allocator());
+
     /// @brief copy constructor
     /// @param other map to copy from
+    /// @remarks the copy has the same buckets and the same chains in the same
+    /// order, so nothing is hashed again. its nodes come out of a single
+    /// allocation, laid out in bucket order.
     Hashmap(const Hashmap &other);
 
     /// @brief move constructor
@@ -52,6 +269,9 @@ template <typename TKey, typename TValue> class Hashmap {
     /// @return bool if the operation succeeded
     /// @param key the key of the item to be added
     /// @param value the value of the item to be added
+    /// @remarks when the add grows the map, the items stay in the old buckets
+    /// and each add or remove after it moves a few buckets over, so no single
+    /// call rehashes the whole map
     bool add(const TKey &key, const TValue &value);
 
     /// @brief adds a new item to the list, overwrites any item of the same key
@@ -59,8 +279,85 @@ template <typename TKey, typename TValue> class Hashmap {
     /// @param value the value of the item to be added
     void put(const TKey &key, const TValue &value);
 
+    /// @brief attempts to add a new item, moving the key and value in
+    /// @return bool if the operation succeeded
+    bool add(TKey &&key, TValue &&value);
+
+    /// @brief adds a new item or overwrites the item of the same key, moving
+    /// the key and value in
+    void put(TKey &&key, TValue &&value);
+
+    /// @brief adds an item whose key is made from key and whose value is
+    /// made in place from args, unless the key is already in the map
+    /// @returns an iterator to the item at the key, and whether it was added
+    /// @remarks the key is made either way, try_emplace avoids that when
+    /// you already hold a TKey. the value is only made if the item is added.
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> emplace(K &&key, Args &&...args);
+
+    /// @brief adds an item with its value made in place from args, unless
+    /// the key is already in the map
+    /// @returns an iterator to the item at the key, and whether it was added
+    /// @remarks if the key is there, args are left untouched, so a value
+    /// passed as an rvalue is not moved from
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const TKey &key, Args &&...args);
+
+    /// @brief try_emplace, moving the key in if the item is added
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(TKey &&key, Args &&...args);
+
+    /// @brief adds an item, or assigns value to the item already at the key
+    /// @returns an iterator to the item at the key, and whether it was added
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const TKey &key, M &&value);
+
+    /// @brief insert_or_assign, moving the key in if the item is added
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(TKey &&key, M &&value);
+
+    /// @brief adds the items from first to last, either std::pairs or the
+    /// entries of another map, skipping keys already in the map
+    /// @remarks forward iterators are counted first and the map reserves
+    /// room for all of them at once, so it grows at most one time
+    template <typename InputIt, if_input_iterator<InputIt> = 0>
+    void insert(InputIt first, InputIt last);
+
+    /// @brief insert(first, last) for a whole range
+    /// @remarks sized and forward ranges reserve room up front
+    template <typename Range> void insert_range(Range &&range);
+
+    /// @brief makes a map holding the items of range, std::pairs or the
+    /// entries of another map, built by threads worker threads
+    /// @param threads how many threads share the work, the calling one
+    /// among them. 0 uses one per hardware thread.
+    /// @remarks every worker first makes the nodes of one slice of range
+    /// and sorts them by the range of buckets they go to, then every worker
+    /// links the nodes of one range of buckets. no two workers ever touch
+    /// the same bucket, so none of it takes a lock. when a key comes up
+    /// twice, the first item wins, as with the range constructor. the nodes
+    /// come out of a single allocation and are constructed on the workers,
+    /// so Allocator has to allow that.
+    template <std::ranges::random_access_range Range>
+    static Hashmap parallel_build(const Range &range, unsigned threads = 0,
+                                  const Allocator &alloc = Allocator());
+
+    /// @brief adds a copy of every item of other whose key is not in the map
+    /// yet, the same as adding them one by one
+    /// @remarks reserves room for both maps together first. with cached
+    /// hashes and a stateless Hash, the hashes come from other's nodes
+    /// instead of hashing every key again
+    void merge(const Hashmap &other);
+
+    /// @brief moves over every item of other whose key is not in the map
+    /// yet, leaving other with only the items whose keys clash
+    /// @remarks when both maps share an allocator the nodes are relinked as
+    /// they are, nothing is allocated, moved or hashed again
+    void merge(Hashmap &&other);
+
     /// @brief removes the item at the key
     /// @throws key_not_found if the key was not found
+    /// @remarks never shrinks the map, see optimize
     /// @return TValue the value of the item that was removed
     /// @param key the key of the item to be removed
     TValue remove(const TKey &key);
@@ -82,62 +379,308 @@ template <typename TKey, typename TValue> class Hashmap {
     /// @throws key_not_found if the key was not found
     const TValue &get(const TKey &key) const;
 
+    /// @brief removes the item at a key of another type, such as a
+    /// std::string_view for a std::string key, without making a TKey
+    /// @remarks only there when both Hash and KeyEqual are transparent
+    /// @throws key_not_found if the key was not found
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    TValue remove(const K &key);
+
+    /// @brief checks for a key of another type without making a TKey
+    /// @remarks only there when both Hash and KeyEqual are transparent
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    bool contains(const K &key) const;
+
+    /// @brief gets the value at a key of another type without making a TKey
+    /// @remarks only there when both Hash and KeyEqual are transparent
+    /// @throws key_not_found if the key was not found
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    TValue &get(const K &key);
+
+    /// @brief gets the value at a key of another type without making a TKey
+    /// @remarks only there when both Hash and KeyEqual are transparent
+    /// @throws key_not_found if the key was not found
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    const TValue &get(const K &key) const;
+
+    /// @brief finds the item at the key
+    /// @returns an iterator to the item, or end() if the key is not there
+    iterator find(const TKey &key);
+    const_iterator find(const TKey &key) const;
+
+    /// @brief gets the value at the key without throwing on a miss
+    /// @returns a pointer to the value, or nullptr if the key is not there
+    TValue *try_get(const TKey &key);
+    const TValue *try_get(const TKey &key) const;
+
+    /// @brief gets a copy of the value at the key
+    /// @returns the value, or fallback if the key is not there
+    TValue get_or(const TKey &key, const TValue &fallback) const;
+
+    /// @brief removes the item at the key if there is one
+    /// @returns size_t the number of items removed, 0 or 1
+    size_t erase(const TKey &key);
+
+    /// @brief find, for a key of another type
+    /// @remarks only there when both Hash and KeyEqual are transparent
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    iterator find(const K &key);
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    const_iterator find(const K &key) const;
+
+    /// @brief try_get, for a key of another type
+    /// @remarks only there when both Hash and KeyEqual are transparent
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    TValue *try_get(const K &key);
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    const TValue *try_get(const K &key) const;
+
+    /// @brief get_or, for a key of another type
+    /// @remarks only there when both Hash and KeyEqual are transparent
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    TValue get_or(const K &key, const TValue &fallback) const;
+
+    /// @brief erase, for a key of another type
+    /// @remarks only there when both Hash and KeyEqual are transparent
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    size_t erase(const K &key);
+
+    /// @brief takes the item at the key out of the map, node and all
+    /// @returns a handle owning the node, empty if the key was not found
+    /// @remarks nothing is copied or freed, see insert. a node that a copy
+    /// made as part of its single allocation is copied into a node of its
+    /// own first, if that throws the item stays in the map.
+    node_type extract(const TKey &key);
+
+    /// @brief puts a node taken out by extract into the map
+    /// @returns an iterator to the item at the node's key, and whether the
+    /// node went in. when the key is already in the map the handle keeps
+    /// its node, and an empty handle adds nothing.
+    /// @remarks the node is linked in as it is when both maps share an
+    /// allocator, otherwise its key and value are moved into a new node
+    std::pair<iterator, bool> insert(node_type &&node);
+
     /// @brief returns the number of items in the map
     /// @returns size_t the number of items in the map
     size_t size() const;
 
+    /// @brief returns an iterator to the first item
+    /// @remarks items come bucket by bucket, in no particular order. only
+    /// buckets are visited, never a copy of an item.
+    iterator begin();
+    const_iterator begin() const;
+    const_iterator cbegin() const;
+
+    /// @brief returns the iterator past the last item
+    iterator end();
+    const_iterator end() const;
+    const_iterator cend() const;
+
     /// @brief removes all data in the map
+    /// @remarks keeps the current buckets, see optimize. with a PoolAllocator
+    /// that no other map shares, the nodes are freed a slab at a time
+    /// instead of one by one.
     void clear();
-    
-    /// @brief reduces the amount of extra space in the map, freeing extra memory where available.
+
+    /// @brief returns a copy of the allocator the map was made with
+    Allocator get_allocator() const;
+
+    /// @brief returns a copy of the hasher the map uses
+    Hash hash_function() const;
+
+    /// @brief returns a copy of the key comparison the map uses
+    KeyEqual key_eq() const;
+
+    /// @brief returns the average number of items per bucket
+    /// @returns float the current load factor
+    float load_factor() const;
+
+    /// @brief returns the load factor the map is allowed to reach before it
+    /// grows
+    /// @returns float the maximum load factor
+    float max_load_factor() const;
+
+    /// @brief sets the load factor the map is allowed to reach before it
+    /// grows, growing right away if the map is already above it
+    /// @param ml the new maximum load factor
+    /// @throws std::invalid_argument if ml is not positive
+    void max_load_factor(float ml);
+
+    /// @brief returns the number of buckets
+    /// @remarks right after the map grew, this is already the new count even
+    /// though some items still wait in the old buckets
+    size_t bucket_count() const;
+
+    /// @brief makes room for count items, so adding up to count items never
+    /// grows the map
+    /// @remarks never shrinks the map. this, rehash and shrink_to_fit move
+    /// every item at once rather than a few buckets at a time.
+    void reserve(size_t count);
+
+    /// @brief sets the number of buckets to at least count, and at least
+    /// what the items already in the map need
+    /// @remarks unlike reserve, this can shrink the map
+    void rehash(size_t count);
+
+    /// @brief rehash, with threads worker threads moving the items
+    /// @param threads how many threads share the work, the calling one
+    /// among them. 0 uses one per hardware thread.
+    /// @remarks every worker notes the new bucket of every node in one
+    /// range of old buckets, then every worker links the nodes headed for
+    /// one range of new buckets, so none of it takes a lock. nothing moves
+    /// until every key is hashed, so if Hash throws the map is left as it
+    /// was, as with rehash(count).
+    void rehash(size_t count, unsigned threads);
+
+    /// @brief shrinks the buckets to the fewest that hold the items at the
+    /// max load factor, with one rehash
+    /// @remarks the map grows on its own whenever an insert pushes it past
+    /// max_load_factor, but it never shrinks on its own: remove and clear
+    /// keep the buckets so that a map which is drained and refilled does not
+    /// rehash back and forth. This and rehash are the only calls that shrink
+    /// the map.
+    void shrink_to_fit();
+
+    /// @brief reduces the amount of extra space in the map, freeing extra
+    /// memory where available
     /// @returns bool if any memory has been freed
+    /// @remarks same as shrink_to_fit
     bool optimize();
 
-    Hashmap<TKey, TValue> &
-    operator=(const Hashmap<TKey, TValue> &map); // copy operator
+    /// @brief copy operator, see the copy constructor
+    Hashmap &operator=(const Hashmap &map);
 
-    Hashmap<TKey, TValue> &
-    operator=(Hashmap<TKey, TValue> &&map); // move operator
+    Hashmap &operator=(Hashmap &&map); // move operator
 
     /// @brief makes a new map, formed by combining two others
-    /// @returns Hashmap<TKey, TValue> the new map to be created
+    /// @returns Hashmap the new map to be created
     /// @param other the map to add to the current map
     /// @remarks if the two maps contain items with the same keys, the
     /// conflicting items of the right map will be ignored.
-    Hashmap<TKey, TValue> operator+(const Hashmap<TKey, TValue> &other) const;
+    Hashmap operator+(const Hashmap &other) const;
 
     /// @brief modifies this map by adding the items of another map
-    /// @returns Hashmap<TKey, TValue>& a reference to this map
+    /// @returns Hashmap& a reference to this map
     /// @param other the map to add to the current map
     /// @remarks if the two maps contain items with the same keys, the
     /// conflicting items of the right map will be ignored.
-    Hashmap<TKey, TValue> &operator+=(const Hashmap<TKey, TValue> &other);
+    Hashmap &operator+=(const Hashmap &other);
+
+    bool operator==(const Hashmap &other) const;
 
-    bool operator==(const Hashmap<TKey, TValue> &other) const;
+    bool operator!=(const Hashmap &other) const;
 
-    bool operator!=(const Hashmap<TKey, TValue> &other) const;
+    friend std::ostream &operator<< <>(std::ostream &out, const Hashmap &map);
 
-    friend std::ostream &operator<< <>(std::ostream &out,
-                                       const Hashmap<TKey, TValue> &map);
+    /// hashes a key once for both the shard and the shard's map, through
+    /// the _hashed members below
+    template <typename, typename, typename, typename, typename, typename>
+    friend class ConcurrentHashmap;
 
   private:
     Node_t **_buckets;
     size_t _bucket_count;
+    /// maps a hash to one of the _bucket_count buckets
+    BucketIndex _index;
     size_t _item_count;
-
-    Hashmap(int count);
-
-    void copy_from(Node_t **source, size_t size);
-    Node_t *get_node(hash_t hval, const TKey &key);
-    const Node_t *get_node(hash_t hval, const TKey &key) const;
-    void add_node(hash_t hval, const TKey &key, const TValue &value);
-    void add_node(hash_t hval, const TKey &key, const TValue &value,
-                  Node_t **target_buckets, size_t target_count);
-
-    size_t optimized_size();
+    float _max_load_factor;
+    [[no_unique_address]] Hash _hash;
+    [[no_unique_address]] KeyEqual _equal;
+    NodeAlloc _alloc;
+    /// nodes made by copy_from, all in one allocation that is only freed
+    /// when the map is cleared
+    Node_t *_block;
+    size_t _block_size;
+    /// buckets from before the map grew, emptied into _buckets a few at a
+    /// time so that no single add pays for the whole rehash. nullptr once
+    /// they are all empty. every item is in exactly one of the two.
+    Node_t **_old_buckets;
+    size_t _old_bucket_count;
+    BucketIndex _old_index;
+    /// old buckets below this one are empty
+    size_t _migrated;
+
+    /// @brief the nodes a parallel build has sorted by the range of buckets
+    /// they go to, one list per worker and range
+    struct Partitions {
+        Partitions(size_t workers, size_t bucket_count);
+
+        /// @brief appends node, headed for bucket, to the lists of worker
+        void add(size_t worker, size_t bucket, Node_t *node);
+        /// @brief the first node that worker sorted into range part
+        Node_t *head(size_t worker, size_t part) const;
+
+        size_t workers;
+        /// buckets per range, the last one may hold fewer
+        size_t buckets_per_part;
+        std::vector<Node_t *> heads;
+        std::vector<Node_t **> tails;
+    };
+
+    template <typename K, typename... Args>
+    Node_t *create_node(hash_t hval, K &&key, Args &&...args);
+    void destroy_node(Node_t *node);
+    bool in_block(const Node_t *node) const;
+    void free_block();
+    Node_t **allocate_buckets(size_t count);
+    void deallocate_buckets(Node_t **buckets, size_t count);
+
+    void copy_from(const Hashmap &other);
+    template <typename K> Node_t *get_node(hash_t hval, const K &key);
+    template <typename K>
+    const Node_t *get_node(hash_t hval, const K &key) const;
+    template <typename K>
+    const TValue *find_hashed(hash_t hval, const K &key) const;
+    template <typename K>
+    Node_t *find_in(Node_t *chain, hash_t hval, const K &key) const;
+    template <typename K>
+    ChainedPosition<Node_t> locate(hash_t hval, const K &key) const;
+    ChainedPosition<Node_t> position_of(Node_t **bucket, Node_t *node,
+                                        bool in_old) const;
+    template <typename F> void for_each_node(F f) const;
+    ChainedPosition<Node_t> first_position() const;
+    template <typename K> TValue remove_key(const K &key);
+    template <typename K> TValue remove_hashed(hash_t hval, const K &key);
+    template <typename K> iterator find_key(const K &key) const;
+    template <typename K> size_t erase_key(const K &key);
+    template <typename K> Node_t *unlink_node(hash_t hval, const K &key);
+    template <typename K>
+    Node_t *unlink_from(Node_t **link, hash_t hval, const K &key);
+    iterator link_node(hash_t hval, Node_t **bucket, Node_t *node);
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> try_emplace_hashed(hash_t hval, K &&key,
+                                                 Args &&...args);
+    hash_t hash_from(const Hashmap &other, const Node_t *node) const;
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> try_emplace_key(K &&key, Args &&...args);
+    hash_t hash_of(const Node_t *node) const;
+
+    size_t bucket_count_for(size_t count) const;
+    size_t rehash_bucket_count(size_t count) const;
 
     void resize();
     void resize(size_t newSize);
+    void start_resize(size_t newSize);
+    void migrate_buckets(size_t count);
+    void finish_resize();
+    void free_old_buckets();
+
+    size_t link_part(const Partitions &parts, size_t part);
+    template <typename Work>
+    static void run_workers(size_t workers, Work work);
+    static size_t worker_count(unsigned threads);
 };
 
 #include "hashmap.inc"
+#include "flat_hashmap.h"
+#include "swiss_hashmap.h"
@@ -0,0 +1,71 @@
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+#pragma once
+
+/// @brief what an iterator of a map points at: references to the key and the
+/// value of one item, which stay where the map keeps them
+/// @remarks the key is always const, changing it would lose the item. TValue
+/// is const for a const_iterator.
+template <typename TKey, typename TValue> struct Entry {
+    const TKey &key;
+    TValue &data;
+};
+
+/// @brief result of operator-> on a map iterator, holds the Entry so that
+/// it->key and it->data work
+template <typename TEntry> struct EntryArrow {
+    TEntry entry;
+
+    const TEntry *operator->() const;
+};
+
+/// @brief forward iterator over the items of a map, shared by every storage
+/// @tparam Position where the iterator is in the storage. it has to provide
+/// key(), data(), advance() and operator==, and a default constructed one
+/// has to compare equal to the end of the map
+/// @tparam Const true for a const_iterator, which only hands out const
+/// values
+/// @remarks an iterator stays valid until the map is changed, any add may
+/// rehash every item elsewhere
+template <typename Position, typename TKey, typename TValue, bool Const>
+class MapIterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using iterator_concept = std::forward_iterator_tag;
+    using value_type =
+        Entry<TKey, std::conditional_t<Const, const TValue, TValue>>;
+    using reference = value_type;
+    using pointer = EntryArrow<value_type>;
+    using difference_type = std::ptrdiff_t;
+
+    MapIterator();
+
+    explicit MapIterator(const Position &position);
+
+    /// @brief turns an iterator into a const_iterator
+    template <bool OtherConst,
+              typename = std::enable_if_t<Const && !OtherConst>>
+    MapIterator(const MapIterator<Position, TKey, TValue, OtherConst> &other);
+
+    reference operator*() const;
+
+    pointer operator->() const;
+
+    MapIterator &operator++();
+
+    MapIterator operator++(int);
+
+    bool operator==(const MapIterator &other) const;
+
+    bool operator!=(const MapIterator &other) const;
+
+    /// @brief where the iterator is, for the map it belongs to
+    const Position &position() const;
+
+  private:
+    Position _position;
+};
+
+#include "map_iterator.inc"
@@ -0,0 +1,141 @@
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+#pragma once
+
+const size_t DEFAULT_POOL_SLAB_BLOCKS = 1024;
+
+/// @brief hands out fixed size blocks carved from large slabs
+/// @remarks the block size is picked by the first allocation. freed blocks
+/// go on a free list for reuse, and release gives every slab back at once
+/// without visiting the blocks in it.
+class SlabArena {
+  public:
+    /// @param blocks_per_slab how many blocks each new slab holds
+    explicit SlabArena(size_t blocks_per_slab = DEFAULT_POOL_SLAB_BLOCKS);
+
+    SlabArena(const SlabArena &other) = delete;
+    SlabArena &operator=(const SlabArena &other) = delete;
+
+    ~SlabArena();
+
+    /// @brief returns the size blocks are handed out in, 0 before the first
+    /// allocation
+    size_t block_size() const;
+
+    /// @brief checks if a block of this size and type comes from the slabs
+    /// @param size a size already rounded by round_size
+    /// @param type tells apart types of the same size, see pool_type_tag
+    bool serves(size_t size, const void *type = nullptr) const;
+
+    /// @brief hands out one block
+    /// @param size a size already rounded by round_size, fixes the block
+    /// size if this is the first allocation
+    /// @param type fixes the type served along with the size
+    void *allocate(size_t size, const void *type = nullptr);
+
+    /// @brief puts a block back on the free list
+    void deallocate(void *block);
+
+    /// @brief frees every slab, invalidating every block handed out
+    void release();
+
+    /// @brief returns the number of slabs currently held
+    size_t slab_count() const;
+
+    /// @brief rounds a size up so that blocks stay suitably aligned
+    static size_t round_size(size_t size);
+
+  private:
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    struct Slab {
+        Slab *next;
+    };
+
+    size_t _block_size;
+    /// the type the block size was fixed for
+    const void *_block_type;
+    size_t _blocks_per_slab;
+    size_t _slab_count;
+    Slab *_slabs;
+    char *_cursor;
+    char *_end;
+    FreeBlock *_free;
+
+    void add_slab();
+};
+
+/// @brief an address unique to T, which an arena keeps to know the type its
+/// blocks are for
+template <typename T> inline const char pool_type_tag = 0;
+
+/// @brief allocator which serves single objects from a SlabArena
+/// @remarks meant for node based containers: every node comes out of a slab
+/// instead of its own malloc, and a container that is the only user of the
+/// arena can drop all of its nodes with release. the first type allocated
+/// one at a time claims the arena, array allocations and single objects of
+/// any other type fall back to operator new. pointers never claim it, as
+/// they are what bucket tables are made of, and a one bucket table would
+/// otherwise take the slabs from the nodes. copies and rebinds share the
+/// same arena, but a copied container gets a fresh one.
+template <typename T> class PoolAllocator {
+  public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    /// @brief makes an allocator with a new arena of its own
+    PoolAllocator();
+
+    /// @brief makes an allocator sharing the arena of another
+    template <typename U> PoolAllocator(const PoolAllocator<U> &other);
+
+    T *allocate(size_t n);
+
+    void deallocate(T *ptr, size_t n);
+
+    /// @brief gives a copied container its own arena
+    PoolAllocator select_on_container_copy_construction() const;
+
+    /// @brief checks if nothing else shares this allocator's arena
+    bool exclusive() const;
+
+    /// @brief frees every block in the arena at once
+    /// @remarks every object handed out as a single block is gone afterwards,
+    /// its destructor must already have been run
+    void release();
+
+    /// @brief returns the number of slabs the arena currently holds
+    size_t slab_count() const;
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &other) const;
+
+    template <typename U>
+    bool operator!=(const PoolAllocator<U> &other) const;
+
+  private:
+    template <typename U> friend class PoolAllocator;
+
+    std::shared_ptr<SlabArena> _arena;
+
+    bool from_arena(size_t n) const;
+};
+
+/// @brief checks if an allocator is a PoolAllocator nothing else shares
+template <typename Alloc> bool pool_is_exclusive(const Alloc &alloc);
+
+template <typename T> bool pool_is_exclusive(const PoolAllocator<T> &alloc);
+
+/// @brief releases a PoolAllocator's arena, does nothing for other
+/// allocators
+template <typename Alloc> void pool_release(Alloc &alloc);
+
+template <typename T> void pool_release(PoolAllocator<T> &alloc);
+
+#include "node_pool.inc"
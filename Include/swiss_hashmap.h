@@ -0,0 +1,501 @@
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#pragma once
+
+#include "hashmap.h"
+
+const float DEFAULT_SWISS_HASHMAP_MAX_LOAD_FACTOR = 0.875f;
+
+/// control byte of a slot that has never held an item
+const int8_t CONTROL_EMPTY = -128;
+/// control byte of a slot whose item was removed (tombstone)
+const int8_t CONTROL_DELETED = -2;
+
+/// @brief a window of control bytes that is matched against a tag in one go,
+/// 32 bytes wide with AVX2, 16 with SSE2 and 16 one byte at a time otherwise
+/// @remarks every match returns a bitmask, bit i set meaning byte i matched
+struct ControlGroup {
+#if defined(__AVX2__)
+    static constexpr size_t width = 32;
+    __m256i ctrl;
+
+    explicit ControlGroup(const int8_t *pos)
+        : ctrl(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(pos))) {}
+
+    uint32_t match(int8_t tag) const {
+        return static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_set1_epi8(tag), ctrl)));
+    }
+
+    uint32_t match_empty() const { return match(CONTROL_EMPTY); }
+
+    uint32_t match_empty_or_deleted() const {
+        // both special bytes are below -1, every tag is 0 or above
+        return static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_cmpgt_epi8(_mm256_set1_epi8(-1), ctrl)));
+    }
+#elif defined(__SSE2__)
+    static constexpr size_t width = 16;
+    __m128i ctrl;
+
+    explicit ControlGroup(const int8_t *pos)
+        : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pos))) {}
+
+    uint32_t match(int8_t tag) const {
+        return static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), ctrl)));
+    }
+
+    uint32_t match_empty() const { return match(CONTROL_EMPTY); }
+
+    uint32_t match_empty_or_deleted() const {
+        // both special bytes are below -1, every tag is 0 or above
+        return static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl)));
+    }
+#else
+    static constexpr size_t width = 16;
+    const int8_t *ctrl;
+
+    explicit ControlGroup(const int8_t *pos) : ctrl(pos) {}
+
+    uint32_t match(int8_t tag) const {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < width; ++i) {
+            mask |= static_cast<uint32_t>(ctrl[i] == tag) << i;
+        }
+        return mask;
+    }
+
+    uint32_t match_empty() const { return match(CONTROL_EMPTY); }
+
+    uint32_t match_empty_or_deleted() const {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < width; ++i) {
+            mask |= static_cast<uint32_t>(ctrl[i] < -1) << i;
+        }
+        return mask;
+    }
+#endif
+};
+
+/// @brief position of a swiss map iterator: a slot index
+template <typename TSlot> struct SwissPosition {
+    /// @brief the end position
+    SwissPosition();
+
+    /// @brief the first full slot
+    SwissPosition(const int8_t *control, TSlot *slots, size_t capacity);
+
+    /// @brief the slot at index, which has to be full
+    SwissPosition(const int8_t *control, TSlot *slots, size_t capacity,
+                  size_t index);
+
+    const auto &key() const;
+    auto &data() const;
+    void advance();
+    bool operator==(const SwissPosition &other) const;
+
+    const int8_t *control;
+    /// nullptr at the end
+    TSlot *slots;
+    size_t index;
+    size_t capacity;
+
+  private:
+    void seek(size_t from);
+};
+
+template <typename TKey, typename TValue, typename Hash, typename KeyEqual,
+          typename Allocator>
+std::ostream &
+operator<<(std::ostream &out,
+           const Hashmap<TKey, TValue, Hash, KeyEqual, swiss_storage, Allocator>
+               &map);
+
+/// @brief open addressing map with a control byte per slot
+/// @remarks each control byte holds a 7 bit tag taken from the hash of the
+/// item in that slot. lookups compare a whole ControlGroup of tags against
+/// the key's tag at once and only touch the slots whose tag matched, so a
+/// miss usually never reads a key at all. groups are probed quadratically
+/// and a probe ends at the first group with an empty slot.
+template <typename TKey, typename TValue, typename Hash, typename KeyEqual,
+          typename Allocator>
+class Hashmap<TKey, TValue, Hash, KeyEqual, swiss_storage, Allocator> {
+    static_assert(
+        std::is_invocable_r<hash_t, const Hash &, const TKey &>::value,
+        "Hash must be callable with a const TKey&");
+    static_assert(std::is_invocable_r<bool, const KeyEqual &, const TKey &,
+                                      const TKey &>::value,
+                  "KeyEqual must be callable with two const TKey&");
+
+    using Slot_t = Slot<TKey, TValue>;
+    using SlotAlloc = typename std::allocator_traits<
+        Allocator>::template rebind_alloc<Slot_t>;
+    using SlotTraits = std::allocator_traits<SlotAlloc>;
+    using ControlAlloc = typename std::allocator_traits<
+        Allocator>::template rebind_alloc<int8_t>;
+    using ControlTraits = std::allocator_traits<ControlAlloc>;
+
+  public:
+    using iterator = MapIterator<SwissPosition<Slot_t>, TKey, TValue, false>;
+    using const_iterator =
+        MapIterator<SwissPosition<Slot_t>, TKey, TValue, true>;
+
+    /// @brief default constructor
+    Hashmap();
+
+    /// @brief makes an empty map which gets its slots from alloc
+    /// @param alloc the allocator to use, rebound to the slot type
+    explicit Hashmap(const Allocator &alloc);
+
+    /// @brief makes an empty map with at least bucket_count slots
+    /// @remarks the slots hold bucket_count * max_load_factor() items
+    /// before the map first grows, see reserve for sizing by items instead
+    explicit Hashmap(size_t bucket_count,
+                     const Allocator &alloc = Allocator());
+
+    /// @brief makes a map holding the items from first to last, either
+    /// std::pairs or the entries of another map
+    /// @remarks forward iterators are counted first, so the map is sized
+    /// once. when a key comes up twice, the first item wins.
+    template <typename InputIt, if_input_iterator<InputIt> = 0>
+    Hashmap(InputIt first, InputIt last,
+            size_t bucket_count = DEFAULT_HASHMAP_BUCKET_COUNT,
+            const Allocator &alloc = Allocator());
+
+    /// @brief copy constructor
+    /// @param other map to copy from
+    Hashmap(const Hashmap &other);
+
+    /// @brief move constructor
+    /// @param other map to move from
+    Hashmap(Hashmap &&other);
+
+    ~Hashmap();
+
+    /// @brief attempts to add a new item, fails if the item already exists
+    /// @return bool if the operation succeeded
+    /// @param key the key of the item to be added
+    /// @param value the value of the item to be added
+    bool add(const TKey &key, const TValue &value);
+
+    /// @brief adds a new item to the list, overwrites any item of the same key
+    /// @param key the key of the item to be added
+    /// @param value the value of the item to be added
+    void put(const TKey &key, const TValue &value);
+
+    /// @brief attempts to add a new item, moving the key and value in
+    /// @return bool if the operation succeeded
+    bool add(TKey &&key, TValue &&value);
+
+    /// @brief adds a new item or overwrites the item of the same key, moving
+    /// the key and value in
+    void put(TKey &&key, TValue &&value);
+
+    /// @brief adds an item whose key is made from key and whose value is
+    /// made in place from args, unless the key is already in the map
+    /// @returns an iterator to the item at the key, and whether it was added
+    /// @remarks the key is made either way, try_emplace avoids that when
+    /// you already hold a TKey. the value is only made if the item is added.
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> emplace(K &&key, Args &&...args);
+
+    /// @brief adds an item with its value made in place from args, unless
+    /// the key is already in the map
+    /// @returns an iterator to the item at the key, and whether it was added
+    /// @remarks if the key is there, args are left untouched, so a value
+    /// passed as an rvalue is not moved from
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const TKey &key, Args &&...args);
+
+    /// @brief try_emplace, moving the key in if the item is added
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(TKey &&key, Args &&...args);
+
+    /// @brief adds an item, or assigns value to the item already at the key
+    /// @returns an iterator to the item at the key, and whether it was added
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const TKey &key, M &&value);
+
+    /// @brief insert_or_assign, moving the key in if the item is added
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(TKey &&key, M &&value);
+
+    /// @brief adds the items from first to last, either std::pairs or the
+    /// entries of another map, skipping keys already in the map
+    /// @remarks forward iterators are counted first and the map reserves
+    /// room for all of them at once, so it grows at most one time
+    template <typename InputIt, if_input_iterator<InputIt> = 0>
+    void insert(InputIt first, InputIt last);
+
+    /// @brief insert(first, last) for a whole range
+    /// @remarks sized and forward ranges reserve room up front
+    template <typename Range> void insert_range(Range &&range);
+
+    /// @brief adds a copy of every item of other whose key is not in the map
+    /// yet, the same as adding them one by one
+    /// @remarks reserves room for both maps together first
+    void merge(const Hashmap &other);
+
+    /// @brief moves over every item of other whose key is not in the map
+    /// yet, leaving other with only the items whose keys clash
+    /// @remarks the keys and values are moved out of other's slots
+    void merge(Hashmap &&other);
+
+    /// @brief removes the item at the key
+    /// @throws key_not_found if the key was not found
+    /// @return TValue the value of the item that was removed
+    /// @param key the key of the item to be removed
+    /// @remarks never shrinks the map, see optimize
+    TValue remove(const TKey &key);
+
+    /// @brief checks if there is an item with that key
+    /// @returns bool if the key exists, return true; else false
+    /// @param key the key of the item to check
+    bool contains(const TKey &key) const;
+
+    /// @brief gets the value attatched to the key
+    /// @returns TValue& the value which was attatched to the key
+    /// @param key the key of the item we want to get
+    /// @throws key_not_found if the key was not found
+    TValue &get(const TKey &key);
+
+    /// @brief gets the value attatched to the key
+    /// @returns const TValue& the value which was attatched to the key
+    /// @param key the key of the item we want to get
+    /// @throws key_not_found if the key was not found
+    const TValue &get(const TKey &key) const;
+
+    /// @brief removes the item at a key of another type, such as a
+    /// std::string_view for a std::string key, without making a TKey
+    /// @remarks only there when both Hash and KeyEqual are transparent
+    /// @throws key_not_found if the key was not found
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    TValue remove(const K &key);
+
+    /// @brief checks for a key of another type without making a TKey
+    /// @remarks only there when both Hash and KeyEqual are transparent
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    bool contains(const K &key) const;
+
+    /// @brief gets the value at a key of another type without making a TKey
+    /// @remarks only there when both Hash and KeyEqual are transparent
+    /// @throws key_not_found if the key was not found
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    TValue &get(const K &key);
+
+    /// @brief gets the value at a key of another type without making a TKey
+    /// @remarks only there when both Hash and KeyEqual are transparent
+    /// @throws key_not_found if the key was not found
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    const TValue &get(const K &key) const;
+
+    /// @brief finds the item at the key
+    /// @returns an iterator to the item, or end() if the key is not there
+    iterator find(const TKey &key);
+    const_iterator find(const TKey &key) const;
+
+    /// @brief gets the value at the key without throwing on a miss
+    /// @returns a pointer to the value, or nullptr if the key is not there
+    TValue *try_get(const TKey &key);
+    const TValue *try_get(const TKey &key) const;
+
+    /// @brief gets a copy of the value at the key
+    /// @returns the value, or fallback if the key is not there
+    TValue get_or(const TKey &key, const TValue &fallback) const;
+
+    /// @brief removes the item at the key if there is one
+    /// @returns size_t the number of items removed, 0 or 1
+    size_t erase(const TKey &key);
+
+    /// @brief find, for a key of another type
+    /// @remarks only there when both Hash and KeyEqual are transparent
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    iterator find(const K &key);
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    const_iterator find(const K &key) const;
+
+    /// @brief try_get, for a key of another type
+    /// @remarks only there when both Hash and KeyEqual are transparent
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    TValue *try_get(const K &key);
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    const TValue *try_get(const K &key) const;
+
+    /// @brief get_or, for a key of another type
+    /// @remarks only there when both Hash and KeyEqual are transparent
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    TValue get_or(const K &key, const TValue &fallback) const;
+
+    /// @brief erase, for a key of another type
+    /// @remarks only there when both Hash and KeyEqual are transparent
+    template <typename K, typename H = Hash, typename E = KeyEqual,
+              if_transparent<H, E> = 0>
+    size_t erase(const K &key);
+
+    /// @brief returns the number of items in the map
+    /// @returns size_t the number of items in the map
+    size_t size() const;
+
+    /// @brief returns an iterator to the first item
+    /// @remarks items come in slot order, which has nothing to do with the
+    /// order they were added in. empty slots are skipped a whole
+    /// ControlGroup at a time.
+    iterator begin();
+    const_iterator begin() const;
+    const_iterator cbegin() const;
+
+    /// @brief returns the iterator past the last item
+    iterator end();
+    const_iterator end() const;
+    const_iterator cend() const;
+
+    /// @brief removes all data in the map
+    /// @remarks keeps the current slots, see optimize
+    void clear();
+
+    /// @brief returns a copy of the allocator the map was made with
+    Allocator get_allocator() const;
+
+    /// @brief returns a copy of the hasher the map uses
+    Hash hash_function() const;
+
+    /// @brief returns a copy of the key comparison the map uses
+    KeyEqual key_eq() const;
+
+    /// @brief returns the fraction of slots in use
+    /// @returns float the current load factor
+    float load_factor() const;
+
+    /// @brief returns the load factor the map is allowed to reach before it
+    /// grows
+    /// @returns float the maximum load factor
+    float max_load_factor() const;
+
+    /// @brief sets the load factor the map is allowed to reach before it
+    /// grows, growing right away if the map is already above it
+    /// @param ml the new maximum load factor
+    /// @throws std::invalid_argument if ml is not in (0, 1]
+    void max_load_factor(float ml);
+
+    /// @brief returns the number of slots
+    size_t bucket_count() const;
+
+    /// @brief makes room for count items, so adding up to count items never
+    /// grows the map
+    /// @remarks never shrinks the map
+    void reserve(size_t count);
+
+    /// @brief sets the number of slots to at least count, and at least what
+    /// the items already in the map need
+    /// @remarks unlike reserve, this can shrink the map
+    void rehash(size_t count);
+
+    /// @brief shrinks the slots to the fewest that hold the items at the
+    /// max load factor, with one rehash
+    /// @remarks like the chained map, this and rehash are the only calls
+    /// that shrink
+    void shrink_to_fit();
+
+    /// @brief reduces the amount of extra space in the map, freeing extra
+    /// memory where available.
+    /// @returns bool if any memory has been freed
+    /// @remarks same as shrink_to_fit
+    bool optimize();
+
+    Hashmap &operator=(const Hashmap &map); // copy operator
+
+    Hashmap &operator=(Hashmap &&map); // move operator
+
+    /// @brief makes a new map, formed by combining two others
+    /// @returns Hashmap the new map to be created
+    /// @param other the map to add to the current map
+    /// @remarks if the two maps contain items with the same keys, the
+    /// conflicting items of the right map will be ignored.
+    Hashmap operator+(const Hashmap &other) const;
+
+    /// @brief modifies this map by adding the items of another map
+    /// @returns Hashmap& a reference to this map
+    /// @param other the map to add to the current map
+    /// @remarks if the two maps contain items with the same keys, the
+    /// conflicting items of the right map will be ignored.
+    Hashmap &operator+=(const Hashmap &other);
+
+    bool operator==(const Hashmap &other) const;
+
+    bool operator!=(const Hashmap &other) const;
+
+    friend std::ostream &operator<< <>(std::ostream &out, const Hashmap &map);
+
+    template <typename, typename, typename, typename, typename, typename>
+    friend class ConcurrentHashmap;
+
+  private:
+    /// tag of each slot, or CONTROL_EMPTY / CONTROL_DELETED
+    int8_t *_control;
+    Slot_t *_slots;
+    size_t _capacity;
+    size_t _item_count;
+    /// inserts left before a rehash, tombstones use these up as well
+    size_t _growth_left;
+    float _max_load_factor;
+    [[no_unique_address]] Hash _hash;
+    [[no_unique_address]] KeyEqual _equal;
+    SlotAlloc _alloc;
+
+    static const size_t npos = static_cast<size_t>(-1);
+
+    static int8_t tag_of(hash_t hval);
+    size_t max_items() const;
+
+    void allocate(size_t capacity);
+    void deallocate();
+    void free_arrays(int8_t *control, Slot_t *slots, size_t capacity);
+    void copy_from(const Hashmap &other);
+
+    template <typename K> size_t find_slot(hash_t hval, const K &key) const;
+    template <typename K>
+    const TValue *find_hashed(hash_t hval, const K &key) const;
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> try_emplace_key(K &&key, Args &&...args);
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> try_emplace_hashed(hash_t hval, K &&key,
+                                                 Args &&...args);
+    iterator make_iterator(size_t index) const;
+    template <typename K> iterator find_key(const K &key) const;
+    template <typename K> TValue remove_key(const K &key);
+    template <typename K> TValue remove_hashed(hash_t hval, const K &key);
+    template <typename K> size_t erase_key(const K &key);
+    size_t find_free_slot(hash_t hval) const;
+    template <typename K, typename... Args>
+    size_t add_slot(hash_t hval, K &&key, Args &&...args);
+    template <typename... Args>
+    size_t fill_slot(size_t index, hash_t hval, Args &&...args);
+    void erase_slot(size_t index);
+
+    size_t capacity_for(size_t count) const;
+
+    void resize();
+    void resize(size_t newCapacity);
+};
+
+#include "swiss_hashmap.inc"
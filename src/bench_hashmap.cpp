@@ -0,0 +1,569 @@
+#include "concurrent_hashmap.h"
+#include "hashmap.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using bench_clock = std::chrono::steady_clock;
+
+/// @brief builds the queries for a lookup run
+/// @param count how many keys the maps hold, stored keys are 0, 2, 4, ...
+/// @param miss_percent how many of the queries should be odd, missing keys
+std::vector<int> make_queries(int count, int miss_percent) {
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> pick(0, count - 1);
+    std::uniform_int_distribution<int> percent(0, 99);
+
+    std::vector<int> queries(count);
+    for (int &query : queries) {
+        query = pick(rng) * 2 + (percent(rng) < miss_percent ? 1 : 0);
+    }
+    return queries;
+}
+
+/// @brief fills a map with count even keys
+template <typename Map> void fill(Map &map, int count) {
+    for (int i = 0; i < count; ++i) {
+        map.add(i * 2, i);
+    }
+}
+
+/// @brief times contains() over all queries
+/// @returns double nanoseconds per lookup
+template <typename Map>
+double time_lookups(const Map &map, const std::vector<int> &queries,
+                    size_t &found) {
+    auto start = bench_clock::now();
+    for (int query : queries) {
+        found += map.contains(query);
+    }
+    auto elapsed = bench_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() /
+           queries.size();
+}
+
+void bench_lookups(int count) {
+    Hashmap<int, int> chained;
+    Hashmap<int, int, hasher<int>, std::equal_to<>, flat_storage> flat;
+    Hashmap<int, int, hasher<int>, std::equal_to<>, swiss_storage> swiss;
+    fill(chained, count);
+    fill(flat, count);
+    fill(swiss, count);
+
+    std::cout << "lookups, " << count << " keys (ns per lookup)\n"
+              << std::setw(8) << "misses" << std::setw(12) << "chained"
+              << std::setw(12) << "flat" << std::setw(12) << "swiss"
+              << "\n";
+
+    size_t found = 0;
+    for (int miss_percent : {0, 50, 90, 100}) {
+        std::vector<int> queries = make_queries(count, miss_percent);
+        std::cout << std::setw(7) << miss_percent << "%" << std::fixed
+                  << std::setprecision(1) << std::setw(12)
+                  << time_lookups(chained, queries, found) << std::setw(12)
+                  << time_lookups(flat, queries, found) << std::setw(12)
+                  << time_lookups(swiss, queries, found) << "\n";
+    }
+    // keeps the lookups from being optimized away
+    std::cout << "(" << found << " hits)\n\n";
+}
+
+/// @brief times filling a map with count keys and then clearing it, and
+/// prints both
+template <typename Map> void time_load_and_clear(int count) {
+    Map map;
+    auto start = bench_clock::now();
+    fill(map, count);
+    auto filled = bench_clock::now();
+    map.clear();
+    auto cleared = bench_clock::now();
+
+    std::cout << std::fixed << std::setprecision(1) << std::setw(12)
+              << std::chrono::duration<double, std::milli>(filled - start)
+                     .count()
+              << std::setw(12)
+              << std::chrono::duration<double, std::milli>(cleared - filled)
+                     .count();
+}
+
+void bench_allocators(int count) {
+    std::cout << "chained load and clear, " << count << " keys (ms)\n"
+              << std::setw(12) << "allocator" << std::setw(12) << "load"
+              << std::setw(12) << "clear"
+              << "\n";
+
+    std::cout << std::setw(12) << "std";
+    time_load_and_clear<Hashmap<int, int>>(count);
+    std::cout << "\n" << std::setw(12) << "pool";
+    time_load_and_clear<
+        Hashmap<int, int, hasher<int>, std::equal_to<>, chained_storage<>,
+                PoolAllocator<std::pair<const int, int>>>>(count);
+    std::cout << "\n\n";
+}
+
+/// @brief times loading items into an empty map, one add at a time and
+/// with one insert(first, last)
+/// @returns the two times in milliseconds, the best of two rounds so that
+/// the first touch of freshly mapped memory is not counted against either
+template <typename Map>
+std::pair<double, double>
+time_bulk_load(const std::vector<std::pair<int, int>> &items) {
+    double add_ms = 1e300;
+    double insert_ms = 1e300;
+    for (int round = 0; round < 2; ++round) {
+        auto start = bench_clock::now();
+        {
+            Map bulk;
+            bulk.insert(items.begin(), items.end());
+            insert_ms = std::min(
+                insert_ms, std::chrono::duration<double, std::milli>(
+                               bench_clock::now() - start)
+                               .count());
+        }
+        start = bench_clock::now();
+        {
+            Map one_by_one;
+            for (const auto &item : items) {
+                one_by_one.add(item.first, item.second);
+            }
+            add_ms = std::min(add_ms, std::chrono::duration<double, std::milli>(
+                                          bench_clock::now() - start)
+                                          .count());
+        }
+    }
+    return {add_ms, insert_ms};
+}
+
+void bench_bulk_load(int count) {
+    std::cout << "loading " << count << " random keys (ms)\n"
+              << std::setw(8) << "storage" << std::setw(12) << "add loop"
+              << std::setw(12) << "insert"
+              << "\n";
+
+    std::mt19937 rng(1234);
+    std::vector<std::pair<int, int>> items(count);
+    for (int i = 0; i < count; ++i) {
+        items[i] = {static_cast<int>(rng()), i};
+    }
+
+    auto print = [](const char *name, std::pair<double, double> times) {
+        std::cout << std::setw(8) << name << std::fixed
+                  << std::setprecision(1) << std::setw(12) << times.first
+                  << std::setw(12) << times.second << "\n";
+    };
+    print("chained", time_bulk_load<Hashmap<int, int>>(items));
+    print("flat", time_bulk_load<Hashmap<int, int, hasher<int>,
+                                         std::equal_to<>, flat_storage>>(
+                      items));
+    print("swiss", time_bulk_load<Hashmap<int, int, hasher<int>,
+                                          std::equal_to<>, swiss_storage>>(
+                       items));
+    std::cout << "\n";
+}
+
+void bench_parallel_build(int count) {
+    std::cout << "parallel build and rehash of " << count
+              << " random keys (ms, " << std::thread::hardware_concurrency()
+              << " hardware threads)\n"
+              << std::setw(8) << "threads" << std::setw(12) << "build"
+              << std::setw(12) << "rehash x4"
+              << "\n";
+
+    std::mt19937 rng(1234);
+    std::vector<std::pair<int, int>> items(count);
+    for (int i = 0; i < count; ++i) {
+        items[i] = {static_cast<int>(rng()), i};
+    }
+    auto ms_since = [](bench_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(bench_clock::now() -
+                                                         start)
+            .count();
+    };
+
+    auto start = bench_clock::now();
+    Hashmap<int, int> serial(items.begin(), items.end());
+    double build = ms_since(start);
+    start = bench_clock::now();
+    serial.rehash(serial.bucket_count() * 4);
+    std::cout << std::setw(8) << "serial" << std::fixed
+              << std::setprecision(1) << std::setw(12) << build
+              << std::setw(12) << ms_since(start) << "\n";
+
+    for (unsigned threads : {1u, 2u, 4u, 8u}) {
+        start = bench_clock::now();
+        auto map = Hashmap<int, int>::parallel_build(items, threads);
+        build = ms_since(start);
+        start = bench_clock::now();
+        map.rehash(map.bucket_count() * 4, threads);
+        std::cout << std::setw(8) << threads << std::setw(12) << build
+                  << std::setw(12) << ms_since(start) << "\n";
+    }
+    std::cout << "\n";
+}
+
+/// @brief the bucket count the old optimize() settled on: starting from 16,
+/// it counted every item into each candidate bucket count in turn, until no
+/// bucket held more than 16 items
+template <typename Map> size_t chain_scan_bucket_count(const Map &map) {
+    for (size_t buckets = 16;; buckets *= 2) {
+        pow2_buckets index(buckets);
+        std::vector<int> counts(buckets, 0);
+        for (auto entry : map) {
+            ++counts[index(map.hash_function()(entry.key))];
+        }
+        if (*std::max_element(counts.begin(), counts.end()) <= 16) {
+            return buckets;
+        }
+    }
+}
+
+void bench_shrink(int count) {
+    std::cout << "shrinking, " << count << " keys in "
+              << count * 4 << " buckets (ms)\n"
+              << std::setw(12) << "chain scan" << std::setw(16)
+              << "shrink_to_fit"
+              << "\n";
+
+    Hashmap<int, int> map;
+    fill(map, count);
+    map.rehash(count * 4);
+
+    auto start = bench_clock::now();
+    size_t scanned = chain_scan_bucket_count(map);
+    auto scanned_at = bench_clock::now();
+    map.shrink_to_fit();
+    auto shrunk = bench_clock::now();
+
+    std::cout << std::fixed << std::setprecision(1) << std::setw(12)
+              << std::chrono::duration<double, std::milli>(scanned_at - start)
+                     .count()
+              << std::setw(16)
+              << std::chrono::duration<double, std::milli>(shrunk - scanned_at)
+                     .count()
+              << "\n(" << scanned << " and " << map.bucket_count()
+              << " buckets)\n\n";
+}
+
+/// @brief times one walk over every item of a map
+/// @returns double nanoseconds per item
+template <typename Map> double time_walk(const Map &map, size_t &sink) {
+    auto start = bench_clock::now();
+    for (auto entry : map) {
+        sink += entry.data;
+    }
+    auto elapsed = bench_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() /
+           map.size();
+}
+
+void bench_copy(int count) {
+    std::cout << "copying " << count << " keys\n"
+              << std::setw(12) << "copy (ms)" << std::setw(16)
+              << "walk src (ns)" << std::setw(16) << "walk copy (ns)"
+              << "\n";
+
+    Hashmap<int, int> map;
+    std::vector<int> keys = make_queries(count, 0);
+    for (int key : keys) {
+        map.add(key, key);
+    }
+
+    auto start = bench_clock::now();
+    Hashmap<int, int> copy(map);
+    auto copied = bench_clock::now();
+
+    size_t sink = 0;
+    double walk_map = time_walk(map, sink);
+    double walk_copy = time_walk(copy, sink);
+    std::cout << std::fixed << std::setprecision(1) << std::setw(12)
+              << std::chrono::duration<double, std::milli>(copied - start)
+                     .count()
+              << std::setprecision(2) << std::setw(16) << walk_map
+              << std::setw(16) << walk_copy << "\n(" << (sink & 0xFF)
+              << ")\n\n";
+}
+
+/// @brief a Hashmap behind one mutex, what the sharded map replaces
+struct LockedHashmap {
+    std::mutex mutex;
+    Hashmap<int, int> map;
+
+    bool contains(int key) {
+        std::lock_guard lock(mutex);
+        return map.contains(key);
+    }
+    void put(int key, int value) {
+        std::lock_guard lock(mutex);
+        map.put(key, value);
+    }
+};
+
+/// @brief runs the same mix of contains and put on every thread
+/// @param write_every one operation in this many is a put
+/// @returns double million operations per second over all threads
+template <typename Map>
+double time_threads(Map &map, int threads, int count, int ops,
+                    int write_every) {
+    std::vector<std::thread> workers;
+    // keeps the lookups from being optimized away
+    std::atomic<size_t> found = 0;
+    auto start = bench_clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&map, &found, t, count, ops, write_every] {
+            std::mt19937 rng(t);
+            std::uniform_int_distribution<int> pick(0, count - 1);
+            size_t hits = 0;
+            for (int i = 0; i < ops; ++i) {
+                int key = pick(rng);
+                if (i % write_every == 0) {
+                    map.put(key, i);
+                } else {
+                    hits += map.contains(key);
+                }
+            }
+            found += hits;
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    auto elapsed = bench_clock::now() - start;
+    return threads * static_cast<double>(ops) /
+           std::chrono::duration<double, std::micro>(elapsed).count();
+}
+
+void bench_concurrent(int count) {
+    std::cout << "concurrent throughput, " << count << " keys, 90% reads"
+              << " (Mops/s, " << std::thread::hardware_concurrency()
+              << " hardware threads)\n"
+              << std::setw(8) << "threads" << std::setw(12) << "one mutex"
+              << std::setw(12) << "sharded"
+              << "\n";
+
+    LockedHashmap locked;
+    ConcurrentHashmap<int, int> sharded;
+    for (int i = 0; i < count; ++i) {
+        locked.map.add(i, i);
+        sharded.add(i, i);
+    }
+    const int ops = 200000;
+    for (int threads = 1; threads <= 64; threads *= 2) {
+        std::cout << std::setw(8) << threads << std::fixed
+                  << std::setprecision(2) << std::setw(12)
+                  << time_threads(locked, threads, count, ops, 10)
+                  << std::setw(12)
+                  << time_threads(sharded, threads, count, ops, 10) << "\n";
+    }
+    std::cout << "\n";
+}
+
+void bench_lock_free_reads(int count) {
+    std::cout << "read mostly throughput, " << count << " keys, 99% reads"
+              << " (Mops/s)\n"
+              << std::setw(8) << "threads" << std::setw(12) << "sharded"
+              << std::setw(12) << "lock-free"
+              << "\n";
+
+    ConcurrentHashmap<int, int> sharded;
+    LockFreeReadHashmap<int, int> lock_free;
+    for (int i = 0; i < count; ++i) {
+        sharded.add(i, i);
+        lock_free.add(i, i);
+    }
+    // frees the buckets and nodes the fill grew out of before timing
+    for (int i = 0; i < 3; ++i) {
+        EpochDomain::instance().collect();
+    }
+    const int ops = 200000;
+    for (int threads = 1; threads <= 64; threads *= 2) {
+        std::cout << std::setw(8) << threads << std::fixed
+                  << std::setprecision(2) << std::setw(12)
+                  << time_threads(sharded, threads, count, ops, 100)
+                  << std::setw(12)
+                  << time_threads(lock_free, threads, count, ops, 100)
+                  << "\n";
+    }
+    std::cout << "\n";
+}
+
+/// @brief times threads looking up random keys in snapshots of the map
+/// @param batch how many lookups share one snapshot
+/// @returns double million lookups per second over all threads
+template <typename Map>
+double time_snapshot_reads(const Map &map, int threads, int count, int ops,
+                           int batch) {
+    std::vector<std::thread> workers;
+    std::atomic<size_t> found = 0;
+    auto start = bench_clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&map, &found, t, count, ops, batch] {
+            std::mt19937 rng(t);
+            std::uniform_int_distribution<int> pick(0, count - 1);
+            size_t hits = 0;
+            for (int i = 0; i < ops; i += batch) {
+                auto snapshot = map.snapshot();
+                for (int j = 0; j < batch; ++j) {
+                    hits += snapshot->contains(pick(rng));
+                }
+            }
+            found += hits;
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    auto elapsed = bench_clock::now() - start;
+    return threads * static_cast<double>(ops) /
+           std::chrono::duration<double, std::micro>(elapsed).count();
+}
+
+void bench_snapshot(int count) {
+    std::cout << "snapshot reads, " << count << " keys (Mops/s)\n"
+              << std::setw(8) << "threads" << std::setw(12) << "lock-free"
+              << std::setw(12) << "snapshot" << std::setw(12) << "batch 100"
+              << "\n";
+
+    LockFreeReadHashmap<int, int> lock_free;
+    Hashmap<int, int> first;
+    for (int i = 0; i < count; ++i) {
+        lock_free.add(i, i);
+        first.add(i, i);
+    }
+    SnapshotHashmap<int, int> snapshots(std::move(first));
+    const int ops = 200000;
+    for (int threads = 1; threads <= 64; threads *= 2) {
+        std::cout << std::setw(8) << threads << std::fixed
+                  << std::setprecision(2) << std::setw(12)
+                  << time_threads(lock_free, threads, count, ops, ops)
+                  << std::setw(12)
+                  << time_snapshot_reads(snapshots, threads, count, ops, 1)
+                  << std::setw(12)
+                  << time_snapshot_reads(snapshots, threads, count, ops, 100)
+                  << "\n";
+    }
+
+    const int versions = 10;
+    auto start = bench_clock::now();
+    for (int v = 0; v < versions; ++v) {
+        snapshots.update([v](Hashmap<int, int> &next) { next.put(v, -v); });
+    }
+    auto elapsed = bench_clock::now() - start;
+    std::cout << "one update publishing a new version: "
+              << std::chrono::duration<double, std::milli>(elapsed).count() /
+                     versions
+              << " ms\n\n";
+}
+
+/// @brief times every add while a map grows from empty to count keys
+/// @returns std::vector<double> the sorted add latencies in microseconds
+template <typename Map> std::vector<double> add_latencies(int count) {
+    Map map;
+    std::vector<double> latencies(count);
+    for (int i = 0; i < count; ++i) {
+        auto start = bench_clock::now();
+        map.add(i, i);
+        latencies[i] = std::chrono::duration<double, std::micro>(
+                           bench_clock::now() - start)
+                           .count();
+    }
+    std::sort(latencies.begin(), latencies.end());
+    return latencies;
+}
+
+void bench_add_latency(int count) {
+    std::cout << "add latency while growing to " << count << " keys (us)\n"
+              << std::setw(12) << "map" << std::setw(10) << "p99"
+              << std::setw(10) << "p99.99" << std::setw(12) << "max"
+              << "\n";
+    auto report = [count](const char *name,
+                          const std::vector<double> &latencies) {
+        std::cout << std::setw(12) << name << std::fixed
+                  << std::setprecision(2) << std::setw(10)
+                  << latencies[count * 99LL / 100] << std::setw(10)
+                  << latencies[count * 9999LL / 10000] << std::setw(12)
+                  << latencies.back() << "\n";
+    };
+    report("chained", add_latencies<Hashmap<int, int>>(count));
+    report("flat",
+           add_latencies<Hashmap<int, int, hasher<int>, std::equal_to<>,
+                                 flat_storage>>(count));
+    report("lock-free", add_latencies<LockFreeReadHashmap<int, int>>(count));
+    std::cout << "\n";
+}
+
+/// @brief times a string hash over keys of one length
+/// @returns double gigabytes hashed per second
+template <typename Hasher>
+double time_string_hash(Hasher hasher, const std::vector<std::string> &keys,
+                        hash_t &sink) {
+    size_t bytes = 0;
+    auto start = bench_clock::now();
+    for (int round = 0; round < 16; ++round) {
+        for (const std::string &key : keys) {
+            sink += hasher(std::string_view(key));
+            bytes += key.size();
+        }
+    }
+    auto elapsed = bench_clock::now() - start;
+    return bytes / std::chrono::duration<double, std::nano>(elapsed).count();
+}
+
+void bench_string_hash() {
+    std::cout << "string hash throughput (GB/s)\n"
+              << std::setw(8) << "length" << std::setw(12) << "hash_bytes"
+              << std::setw(12) << "std::hash"
+              << "\n";
+
+    std::mt19937 rng(1234);
+    hash_t sink = 0;
+    for (size_t length : {8, 16, 32, 64, 256, 4096}) {
+        // about 4MB of keys per length
+        std::vector<std::string> keys((1 << 22) / length);
+        for (std::string &key : keys) {
+            key.resize(length);
+            for (char &c : key) {
+                c = static_cast<char>('a' + rng() % 26);
+            }
+        }
+        std::cout << std::setw(8) << length << std::fixed
+                  << std::setprecision(2) << std::setw(12)
+                  << time_string_hash(
+                         [](std::string_view key) {
+                             return hash_bytes(key.data(), key.size());
+                         },
+                         keys, sink)
+                  << std::setw(12)
+                  << time_string_hash(std::hash<std::string_view>(), keys,
+                                      sink)
+                  << "\n";
+    }
+    // keeps the hashes from being optimized away
+    std::cout << "(" << (sink & 0xFF) << ")\n\n";
+}
+
+int main() {
+    std::cout << "swiss control group width: " << ControlGroup::width
+              << "\n\n";
+    for (int count : {1000, 100000, 1000000}) {
+        bench_lookups(count);
+    }
+    bench_allocators(1000000);
+    bench_shrink(1000000);
+    bench_copy(1000000);
+    bench_concurrent(1000000);
+    bench_lock_free_reads(1000000);
+    bench_snapshot(1000000);
+    bench_add_latency(4000000);
+    bench_bulk_load(10000000);
+    bench_parallel_build(10000000);
+    bench_string_hash();
+    return 0;
+}
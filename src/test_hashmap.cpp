@@ -1,28 +1,204 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest/doctest.h"
+#include "concurrent_hashmap.h"
 #include "gravedata.h"
 #include "hashmap.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <functional>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <map>
+#include <new>
+#include <numeric>
+#include <random>
+#include <ranges>
 #include <regex>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
 #include <vector>
 
 using gint = ian::GraveData;
 using gimap = Hashmap<int, gint>;
+using gfmap = Hashmap<int, gint, hasher<int>, std::equal_to<>, flat_storage>;
+using gsmap = Hashmap<int, gint, hasher<int>, std::equal_to<>, swiss_storage>;
+using gprmap = Hashmap<int, gint, hasher<int>, std::equal_to<>,
+                       chained_storage<prime_buckets>>;
+using gpmap = Hashmap<int, gint, hasher<int>, std::equal_to<>,
+                      chained_storage<>,
+                      PoolAllocator<std::pair<const int, gint>>>;
 
 struct pair {
     int key;
     int value;
 };
 
+/// @brief sends every key to the same hash, so every item collides
+struct constant_hash {
+    hash_t operator()(int) const { return 42; }
+};
+
+/// @brief keeps small keys in their own slot, so nothing is displaced
+struct identity_hash {
+    hash_t operator()(int key) const { return key; }
+};
+
+struct point {
+    int x;
+    int y;
+
+    bool operator==(const point &other) const {
+        return x == other.x && y == other.y;
+    }
+};
+
+template <> struct std::hash<point> {
+    size_t operator()(const point &p) const {
+        return std::hash<int>()(p.x) * 31 + std::hash<int>()(p.y);
+    }
+};
+
+// integers hash at compile time, unsupported types are caught by the trait
+// hasher checks instead of throwing at runtime
+static_assert(hasher<int>()(7) == hash_integral(7));
+static_assert(hash(7u) == hash_integral(7));
+static_assert(has_std_hash<point>::value);
+static_assert(!has_std_hash<pair>::value);
+
+/// @brief default hash of an int, counting its calls
+struct counting_hash {
+    static int calls;
+    hash_t operator()(int key) const {
+        ++calls;
+        return hash(key);
+    }
+};
+int counting_hash::calls = 0;
+
+/// @brief int equality, counting its calls
+struct counting_equal {
+    static int calls;
+    bool operator()(int left, int right) const {
+        ++calls;
+        return left == right;
+    }
+};
+int counting_equal::calls = 0;
+
+/// @brief hashes with a seed of its own, so two maps place keys apart
+struct seeded_hash {
+    static inline hash_t next_seed = 1;
+    hash_t seed = next_seed++;
+    hash_t operator()(int key) const {
+        return hash_bytes(&key, sizeof(key), seed);
+    }
+};
+
+template <bool CacheHash>
+using counting_map = Hashmap<int, int, counting_hash, counting_equal,
+                             chained_storage<pow2_buckets, CacheHash>>;
+
+/// @brief counts every global allocation, for checking that a lookup makes
+/// no temporaries. atomic since the concurrent tests allocate from many
+/// threads.
+static std::atomic<int> allocations = 0;
+
+void *operator new(size_t size) {
+    ++allocations;
+    if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+/// @brief allocations CountingAllocator hands out, across every rebind,
+/// before one throws. -1 never throws.
+static int allocations_left = -1;
+
+/// @brief allocator that keeps track of how many blocks are handed out
+template <typename T> struct CountingAllocator {
+    using value_type = T;
+
+    static int live;
+
+    CountingAllocator() {}
+    template <typename U> CountingAllocator(const CountingAllocator<U> &) {}
+
+    T *allocate(size_t n) {
+        if (allocations_left == 0) {
+            throw std::bad_alloc();
+        }
+        if (allocations_left > 0) {
+            --allocations_left;
+        }
+        ++live;
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T *ptr, size_t n) {
+        --live;
+        std::allocator<T>().deallocate(ptr, n);
+    }
+
+    template <typename U> bool operator==(const CountingAllocator<U> &) const {
+        return true;
+    }
+    template <typename U> bool operator!=(const CountingAllocator<U> &) const {
+        return false;
+    }
+};
+template <typename T> int CountingAllocator<T>::live = 0;
+
+/// @brief total blocks out across every rebind of CountingAllocator
+template <typename TKey, typename TValue, typename Storage>
+int liveBlocks() {
+    using Map = Hashmap<TKey, TValue, hasher<TKey>, std::equal_to<>, Storage,
+                        CountingAllocator<std::pair<const TKey, TValue>>>;
+    (void)sizeof(Map);
+    return CountingAllocator<Node<TKey, TValue>>::live +
+           CountingAllocator<Node<TKey, TValue> *>::live +
+           CountingAllocator<Slot<TKey, TValue>>::live +
+           CountingAllocator<uint32_t>::live + CountingAllocator<int8_t>::live;
+}
+
+/// @brief a value whose copies start throwing after a set number, -1
+/// never throws
+struct Brittle {
+    static inline int copies_left = -1;
+    gint value;
+
+    Brittle(int value) : value(value) {}
+    Brittle(const Brittle& other) : value(other.value) {
+        if (copies_left == 0) {
+            throw std::runtime_error("brittle");
+        }
+        copies_left--;
+    }
+};
+
+/// @brief collects until everything retired so far is freed
+void drain_epochs() {
+    for (int i = 0; i < 3; ++i) {
+        EpochDomain::instance().collect();
+    }
+}
+
 #ifdef DEBUG
-void forceResize(gimap& map) {
+template <typename Map> void forceResize(Map& map) {
     map.resize();
 }
-int getBucketCount(gimap& map) {
+template <typename Map> int getBucketCount(Map& map) {
     return map._bucket_count;
 }
+template <typename Map> size_t getOldBucketCount(Map& map) {
+    return map._old_buckets == nullptr ? 0 : map._old_bucket_count;
+}
 #endif
 
 TEST_SUITE("constructors") {
@@ -339,7 +515,82 @@ TEST_SUITE("methods") {
         for (int i = 0; i < 64; ++i) {
             REQUIRE_EQ(i+1000, map.get(i));
         }
-        CHECK_EQ(16, getBucketCount(map));
+        // one bucket per item at the default max load factor
+        CHECK_EQ(64, getBucketCount(map));
+    }
+
+    TEST_CASE("test load factor") {
+        gimap map;
+
+        CHECK_EQ(0.0f, map.load_factor());
+        CHECK_EQ(DEFAULT_HASHMAP_MAX_LOAD_FACTOR, map.max_load_factor());
+
+        for (int i = 0; i < 8; ++i) {
+            map.add(i, i);
+        }
+
+        CHECK_EQ(0.5f, map.load_factor());
+    }
+    TEST_CASE("test add grows past max load factor") {
+        gint::init();
+
+        gimap map;
+        for (int i = 0; i < 1000; ++i) {
+            map.add(i, i + 1000);
+            REQUIRE_LE(map.load_factor(), map.max_load_factor());
+        }
+
+        CHECK_GE(getBucketCount(map), 1000);
+        CHECK_EQ(1000, gint::count());
+        CHECK_EQ(1000, map.size());
+        for (int i = 0; i < 1000; ++i) {
+            REQUIRE_EQ(i + 1000, map.get(i));
+        }
+    }
+    TEST_CASE("test put grows past max load factor") {
+        gimap map;
+        for (int i = 0; i < 17; ++i) {
+            map.put(i, i);
+        }
+
+        CHECK_EQ(32, getBucketCount(map));
+        CHECK_LE(map.load_factor(), map.max_load_factor());
+    }
+    TEST_CASE("test max load factor setter grows map") {
+        gimap map;
+        for (int i = 0; i < 16; ++i) {
+            map.add(i, i);
+        }
+
+        map.max_load_factor(0.25f);
+
+        CHECK_EQ(0.25f, map.max_load_factor());
+        CHECK_EQ(64, getBucketCount(map));
+        CHECK_EQ(16, map.size());
+        for (int i = 0; i < 16; ++i) {
+            REQUIRE_EQ(i, map.get(i));
+        }
+    }
+    TEST_CASE("test max load factor setter with invalid value") {
+        gimap map;
+
+        CHECK_THROWS_AS(map.max_load_factor(0.0f), std::invalid_argument);
+        CHECK_THROWS_AS(map.max_load_factor(-1.0f), std::invalid_argument);
+        CHECK_EQ(DEFAULT_HASHMAP_MAX_LOAD_FACTOR, map.max_load_factor());
+    }
+    TEST_CASE("test remove does not shrink map") {
+        gimap map;
+        for (int i = 0; i < 64; ++i) {
+            map.add(i, i);
+        }
+        int buckets = getBucketCount(map);
+
+        for (int i = 0; i < 64; ++i) {
+            map.remove(i);
+        }
+
+        CHECK_EQ(0, map.size());
+        CHECK_EQ(buckets, getBucketCount(map));
     }
 }
 
@@ -566,6 +817,24 @@ TEST_SUITE("operators") {
         CHECK_FALSE(map == otherMap);
     }
 
+    TEST_CASE_TEMPLATE("test equals operator with seeded hashers", Storage,
+                       chained_storage<>, chained_storage<pow2_buckets, true>,
+                       flat_storage, swiss_storage) {
+        Hashmap<int, int, seeded_hash, std::equal_to<>, Storage> map;
+        Hashmap<int, int, seeded_hash, std::equal_to<>, Storage> otherMap;
+        for (int i = 0; i < 100; ++i) {
+            map.add(i, -i);
+            otherMap.add(99 - i, i - 99);
+        }
+
+        CHECK(map == otherMap);
+        CHECK(otherMap == map);
+
+        otherMap.put(50, 0);
+
+        CHECK_FALSE(map == otherMap);
+    }
+
     TEST_CASE("test !equals operator with empty map") {
         gimap map;
         gimap otherMap;
@@ -630,40 +899,2483 @@ TEST_SUITE("operators") {
     }
 }
 
-TEST_CASE("test resize with empty map") {
-    gint::init();
-    gimap map;
+TEST_SUITE("flat storage") {
+    TEST_CASE("test flat add and get") {
+        gint::init();
 
-    #ifndef DEBUG
-    INFO("DEBUG macro not defined");
-    REQUIRE(false);
-    #else
-        forceResize(map);
-    #endif
+        gfmap map;
+        CHECK(map.add(1, 9867));
+        CHECK(map.add(2, 9999));
+        CHECK_FALSE(map.add(1, 0));
 
-    CHECK_EQ(0, gint::count());
-    CHECK_EQ(0, map.size());
+        CHECK_EQ(2, gint::count());
+        CHECK_EQ(2, map.size());
+        CHECK_EQ(9867, map.get(1));
+        CHECK_EQ(9999, map.get(2));
+        CHECK_THROWS_AS(map.get(3), key_not_found);
+    }
+    TEST_CASE("test flat put with duplicate key") {
+        gint::init();
+
+        gfmap map;
+        map.put(1, 0);
+        map.put(1, 9867);
+
+        CHECK_EQ(1, gint::count());
+        CHECK_EQ(1, map.size());
+        CHECK_EQ(9867, map.get(1));
+    }
+    TEST_CASE("test flat remove") {
+        gint::init();
+
+        gfmap map;
+        map.add(1, 9867);
+
+        CHECK_THROWS_AS(map.remove(2), key_not_found);
+        CHECK_EQ(9867, map.remove(1));
+        CHECK_THROWS_AS(map.remove(1), key_not_found);
+        CHECK_FALSE(map.contains(1));
+        CHECK_EQ(0, gint::count());
+        CHECK_EQ(0, map.size());
+    }
+    TEST_CASE("test flat remove keeps clusters reachable") {
+        gint::init();
+
+        gfmap map;
+        for (int i = 0; i < 1000; ++i) {
+            map.add(i, i + 1000);
+        }
+        for (int i = 0; i < 1000; i += 2) {
+            REQUIRE_EQ(i + 1000, map.remove(i));
+        }
+
+        CHECK_EQ(500, map.size());
+        CHECK_EQ(500, gint::count());
+        for (int i = 0; i < 1000; ++i) {
+            if (i % 2 == 0) {
+                REQUIRE_FALSE(map.contains(i));
+            } else {
+                REQUIRE_EQ(i + 1000, map.get(i));
+            }
+        }
+    }
+    TEST_CASE("test flat grows past max load factor") {
+        gfmap map;
+        for (int i = 0; i < 1000; ++i) {
+            map.add(i, i);
+            REQUIRE_LE(map.load_factor(), map.max_load_factor());
+        }
+
+        CHECK_THROWS_AS(map.max_load_factor(1.5f), std::invalid_argument);
+        map.max_load_factor(0.25f);
+
+        CHECK_LE(map.load_factor(), 0.25f);
+        for (int i = 0; i < 1000; ++i) {
+            REQUIRE_EQ(i, map.get(i));
+        }
+    }
+    TEST_CASE("test flat clear and destructor") {
+        gint::init();
+
+        gfmap *map = new gfmap;
+        for (int i = 0; i < 100; ++i) {
+            map->add(i, i);
+        }
+        map->clear();
+
+        CHECK_EQ(0, map->size());
+        CHECK_EQ(0, gint::count());
+
+        map->add(1, 1);
+        delete map;
+
+        CHECK_EQ(0, gint::count());
+    }
+    TEST_CASE("test flat optimize") {
+        gfmap map;
+
+        CHECK_FALSE(map.optimize());
+
+        for (int i = 0; i < 1000; ++i) {
+            map.add(i, i);
+        }
+        for (int i = 10; i < 1000; ++i) {
+            map.remove(i);
+        }
+
+        CHECK(map.optimize());
+        CHECK_FALSE(map.optimize());
+        CHECK_EQ(10, map.size());
+        for (int i = 0; i < 10; ++i) {
+            REQUIRE_EQ(i, map.get(i));
+        }
+    }
+    TEST_CASE("test flat copy and move") {
+        gint::init();
+
+        gfmap map;
+        map.add(1, 9867);
+        map.add(2, 9999);
+
+        gfmap copy(map);
+        gfmap assigned;
+        assigned = map;
+
+        CHECK_EQ(6, gint::count());
+        CHECK(copy == map);
+        CHECK(assigned == map);
+
+        gfmap moved(std::move(copy));
+        gfmap moveAssigned;
+        moveAssigned = std::move(assigned);
+
+        CHECK_EQ(6, gint::count());
+        CHECK_EQ(9867, moved.get(1));
+        CHECK_EQ(9999, moveAssigned.get(2));
+    }
+    TEST_CASE("test flat append operators") {
+        gfmap map;
+        map.add(1, 9867);
+        map.add(2, 9999);
+        gfmap otherMap;
+        otherMap.add(2, 1);
+        otherMap.add(3, 2146);
+
+        gfmap newMap = map + otherMap;
+        map += otherMap;
+
+        CHECK(newMap == map);
+        CHECK_FALSE(newMap != map);
+        CHECK_EQ(3, map.size());
+        CHECK_EQ(9999, map.get(2));
+        CHECK_EQ(2146, map.get(3));
+    }
+    TEST_CASE("test flat stream insertion operator") {
+        gfmap map;
+
+        std::stringstream empty;
+        empty << map;
+        CHECK_EQ("{ }", empty.str());
+
+        map.add(1, 9967);
+        std::stringstream stream;
+        stream << map;
+        CHECK_EQ("{ (1, 9967) }", stream.str());
+    }
+    TEST_CASE("test flat storage matches chained storage") {
+        gimap chained;
+        gfmap flat;
+
+        unsigned int seed = 12345;
+        for (int i = 0; i < 20000; ++i) {
+            seed = seed * 1103515245 + 12345;
+            int key = (seed >> 8) % 2000;
+            switch ((seed >> 4) % 3) {
+            case 0:
+                REQUIRE_EQ(chained.add(key, i), flat.add(key, i));
+                break;
+            case 1:
+                chained.put(key, i);
+                flat.put(key, i);
+                break;
+            default:
+                REQUIRE_EQ(chained.contains(key), flat.contains(key));
+                if (chained.contains(key)) {
+                    REQUIRE_EQ(chained.remove(key), flat.remove(key));
+                }
+                break;
+            }
+        }
+
+        CHECK_EQ(chained.size(), flat.size());
+        for (int key = 0; key < 2000; ++key) {
+            REQUIRE_EQ(chained.contains(key), flat.contains(key));
+            if (chained.contains(key)) {
+                REQUIRE_EQ(chained.get(key), flat.get(key));
+            }
+        }
+    }
 }
-TEST_CASE("test resize with non-empty map") {
-    gint::init();
-    gimap map;
 
-    int keys[] = {1, 2, 3, 4};
-    int values[] = {9967, 9999, 1, 2379};
-    for (int i = 0; i < 4; ++i) {
-        map.add(keys[i], values[i]);
+TEST_SUITE("swiss storage") {
+    TEST_CASE("test control group matching") {
+        int8_t control[ControlGroup::width];
+        for (size_t i = 0; i < ControlGroup::width; ++i) {
+            control[i] = CONTROL_EMPTY;
+        }
+        control[0] = 5;
+        control[3] = CONTROL_DELETED;
+        control[ControlGroup::width - 1] = 5;
+
+        ControlGroup group(control);
+
+        uint32_t last = 1u << (ControlGroup::width - 1);
+        CHECK_EQ(1u | last, group.match(5));
+        CHECK_EQ(0u, group.match(6));
+        CHECK_EQ(0u, group.match_empty() & (1u | 1u << 3 | last));
+        CHECK_EQ(1u << 1, group.match_empty() & (1u << 1));
+        CHECK_EQ(0u, group.match_empty_or_deleted() & (1u | last));
+        CHECK_EQ(1u << 3, group.match_empty_or_deleted() & (1u << 3));
     }
-    
-    #ifndef DEBUG
-    #error "DEBUG macro not defined"
-    REQUIRE(false);
-    #else
-        forceResize(map);
-    #endif
+    TEST_CASE("test swiss add and get") {
+        gint::init();
 
-    CHECK_EQ(4, gint::count());
-    CHECK_EQ(4, map.size());
-    CHECK_EQ(9967, map.get(1));
-    CHECK_EQ(9999, map.get(2));
-    CHECK_EQ(1, map.get(3));
+        gsmap map;
+        CHECK(map.add(1, 9867));
+        CHECK(map.add(2, 9999));
+        CHECK_FALSE(map.add(1, 0));
+        map.put(2, 20);
+
+        CHECK_EQ(2, gint::count());
+        CHECK_EQ(2, map.size());
+        CHECK_EQ(9867, map.get(1));
+        CHECK_EQ(20, map.get(2));
+        CHECK_THROWS_AS(map.get(3), key_not_found);
+    }
+    TEST_CASE("test swiss remove") {
+        gint::init();
+
+        gsmap map;
+        map.add(1, 9867);
+
+        CHECK_THROWS_AS(map.remove(2), key_not_found);
+        CHECK_EQ(9867, map.remove(1));
+        CHECK_THROWS_AS(map.remove(1), key_not_found);
+        CHECK_FALSE(map.contains(1));
+        CHECK_EQ(0, gint::count());
+        CHECK_EQ(0, map.size());
+    }
+    TEST_CASE("test swiss churn reuses tombstones") {
+        gint::init();
+
+        gsmap map;
+        for (int round = 0; round < 50; ++round) {
+            for (int i = 0; i < 200; ++i) {
+                map.add(round * 200 + i, i);
+            }
+            for (int i = 0; i < 200; ++i) {
+                REQUIRE_EQ(i, map.remove(round * 200 + i));
+            }
+        }
+
+        CHECK_EQ(0, map.size());
+        CHECK_EQ(0, gint::count());
+        CHECK(map.optimize());
+        CHECK_FALSE(map.contains(0));
+    }
+    TEST_CASE("test swiss grows past max load factor") {
+        gsmap map;
+        for (int i = 0; i < 1000; ++i) {
+            map.add(i, i);
+            REQUIRE_LE(map.load_factor(), map.max_load_factor());
+        }
+
+        CHECK_THROWS_AS(map.max_load_factor(0.0f), std::invalid_argument);
+        map.max_load_factor(0.25f);
+
+        CHECK_LE(map.load_factor(), 0.25f);
+        for (int i = 0; i < 1000; ++i) {
+            REQUIRE_EQ(i, map.get(i));
+        }
+    }
+    TEST_CASE("test swiss copy, move and operators") {
+        gint::init();
+
+        gsmap map;
+        map.add(1, 9867);
+        map.add(2, 9999);
+        gsmap otherMap;
+        otherMap.add(2, 1);
+        otherMap.add(3, 2146);
+
+        gsmap copy(map);
+        CHECK(copy == map);
+        gsmap moved(std::move(copy));
+        CHECK_EQ(9867, moved.get(1));
+
+        gsmap newMap = map + otherMap;
+        map += otherMap;
+
+        CHECK(newMap == map);
+        CHECK(newMap != moved);
+        CHECK_EQ(3, map.size());
+        CHECK_EQ(9999, map.get(2));
+
+        std::stringstream stream;
+        stream << otherMap;
+        CHECK_NE(std::string::npos, stream.str().find("(3, 2146)"));
+    }
+    TEST_CASE("test swiss storage matches chained storage") {
+        gimap chained;
+        gsmap swiss;
+
+        unsigned int seed = 54321;
+        for (int i = 0; i < 20000; ++i) {
+            seed = seed * 1103515245 + 12345;
+            int key = (seed >> 8) % 2000;
+            switch ((seed >> 4) % 3) {
+            case 0:
+                REQUIRE_EQ(chained.add(key, i), swiss.add(key, i));
+                break;
+            case 1:
+                chained.put(key, i);
+                swiss.put(key, i);
+                break;
+            default:
+                REQUIRE_EQ(chained.contains(key), swiss.contains(key));
+                if (chained.contains(key)) {
+                    REQUIRE_EQ(chained.remove(key), swiss.remove(key));
+                }
+                break;
+            }
+        }
+
+        CHECK_EQ(chained.size(), swiss.size());
+        for (int key = 0; key < 2000; ++key) {
+            REQUIRE_EQ(chained.contains(key), swiss.contains(key));
+            if (chained.contains(key)) {
+                REQUIRE_EQ(chained.get(key), swiss.get(key));
+            }
+        }
+    }
+}
+
+TEST_SUITE("string hash") {
+    TEST_CASE("test string hash reads every character") {
+        // the old hash stepped over every second character
+        CHECK_NE(hash_string("ab"), hash_string("ac"));
+        CHECK_NE(hash_string("abcd"), hash_string("abce"));
+        CHECK_NE(hash_string("x"), hash_string(""));
+    }
+    TEST_CASE("test string hash agrees across string types") {
+        std::string key = "a key that is longer than sixteen bytes";
+        hash_t expected = hash_bytes(key.data(), key.size());
+
+        CHECK_EQ(expected, hash(key));
+        CHECK_EQ(expected, hash(std::string_view(key)));
+        CHECK_EQ(expected, hash_string(key.c_str()));
+        CHECK_EQ(expected, hash(static_cast<const char *>(key.c_str())));
+    }
+    TEST_CASE("test string hash counts embedded nulls") {
+        std::string one("a\0b", 3);
+        std::string two("a\0c", 3);
+        CHECK_NE(hash(one), hash(two));
+        CHECK_NE(hash(one), hash(std::string("a")));
+    }
+    TEST_CASE("test string hash seed") {
+        CHECK_NE(hash_bytes("key", 3, 0), hash_bytes("key", 3, 1));
+    }
+    TEST_CASE("test string hash every prefix length") {
+        // covers the short, 4 to 16, 16 byte step and 48 byte lane paths
+        std::string text(200, '\0');
+        for (size_t i = 0; i < text.size(); ++i) {
+            text[i] = static_cast<char>('a' + i % 26);
+        }
+        std::unordered_set<hash_t> hashes;
+        for (size_t length = 0; length <= text.size(); ++length) {
+            hashes.insert(hash_bytes(text.data(), length));
+        }
+        CHECK_EQ(text.size() + 1, hashes.size());
+    }
+    TEST_CASE("test string hash has no collisions on similar keys") {
+        std::unordered_set<hash_t> full;
+        std::unordered_set<hash_t> high;
+        const int count = 200000;
+        for (int i = 0; i < count; ++i) {
+            hash_t hval = hash(std::string("user:") + std::to_string(i));
+            full.insert(hval);
+            high.insert(hval >> 32);
+        }
+        CHECK_EQ(count, full.size());
+        // the old hash never set anything above bit 28
+        CHECK_GT(high.size(), count - 10);
+    }
+    TEST_CASE("test string hash spreads over low bits") {
+        const int buckets = 1024;
+        const int count = buckets * 64;
+        std::vector<int> load(buckets, 0);
+        for (int i = 0; i < count; ++i) {
+            ++load[hash("k" + std::to_string(i)) & (buckets - 1)];
+        }
+        // 64 expected per bucket, the standard deviation is about 8
+        for (int items : load) {
+            REQUIRE_GT(items, 20);
+            REQUIRE_LT(items, 110);
+        }
+    }
+    TEST_CASE("test string hash avalanche") {
+        for (size_t length : {3, 8, 13, 16, 31, 64, 100}) {
+            std::string key(length, 'q');
+            hash_t base = hash(key);
+            int flipped = 0;
+            int flips = 0;
+            for (size_t byte = 0; byte < length; ++byte) {
+                for (int bit = 0; bit < 8; ++bit) {
+                    std::string changed = key;
+                    changed[byte] ^= static_cast<char>(1 << bit);
+                    flipped += __builtin_popcountll(base ^ hash(changed));
+                    ++flips;
+                }
+            }
+            // a good hash flips half of the 64 output bits on average
+            double average = static_cast<double>(flipped) / flips;
+            INFO("length " << length);
+            CHECK_GT(average, 28.0);
+            CHECK_LT(average, 36.0);
+        }
+    }
+    TEST_CASE("test map with string keys") {
+        Hashmap<std::string, int> map;
+        for (int i = 0; i < 1000; ++i) {
+            map.add("key" + std::to_string(i), i);
+        }
+        CHECK_EQ(1000, map.size());
+        for (int i = 0; i < 1000; ++i) {
+            REQUIRE_EQ(i, map.get("key" + std::to_string(i)));
+        }
+        CHECK_FALSE(map.contains("key1000"));
+    }
+}
+
+TEST_SUITE("hashers") {
+    TEST_CASE_TEMPLATE("test map with colliding hash", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        Hashmap<int, int, constant_hash, std::equal_to<>, Storage> map;
+        for (int i = 0; i < 200; ++i) {
+            map.add(i, i + 1000);
+        }
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE_EQ(i + 1000, map.remove(i));
+        }
+
+        CHECK_EQ(100, map.size());
+        CHECK_FALSE(map.contains(50));
+        for (int i = 100; i < 200; ++i) {
+            REQUIRE_EQ(i + 1000, map.get(i));
+        }
+        CHECK_EQ(42, map.hash_function()(7));
+    }
+    TEST_CASE("test hasher falls back to std hash") {
+        // std::hash<point> puts nearby points next to each other, the
+        // fallback has to spread them anyway
+        CHECK_NE(hasher<point>()({0, 1}) & 0xFF,
+                 hasher<point>()({0, 2}) & 0xFF);
+
+        Hashmap<point, int, hasher<point>, std::equal_to<>, swiss_storage>
+            map;
+        for (int i = 0; i < 100; ++i) {
+            map.add({i, -i}, i);
+        }
+        CHECK_EQ(100, map.size());
+        CHECK_EQ(50, map.get({50, -50}));
+        CHECK_FALSE(map.contains({50, 50}));
+    }
+    TEST_CASE("test hasher for enums and strings") {
+        enum class colour { red, green };
+        CHECK_NE(hash(colour::red), hash(colour::green));
+        CHECK_EQ(hash(std::string("abc")), hash("abc"));
+        CHECK_EQ(hash(std::string_view("abc")), hash("abc"));
+    }
+}
+
+TEST_SUITE("transparent lookup") {
+    TEST_CASE_TEMPLATE("test string map lookups without a std::string",
+                       Storage, chained_storage<>, flat_storage,
+                       swiss_storage) {
+        using Map = Hashmap<std::string, int, hasher<std::string>,
+                            std::equal_to<>, Storage>;
+        // long enough to never fit in the small string buffer
+        std::string prefix = "a rather long key used for lookups #";
+        Map map;
+        for (int i = 0; i < 100; ++i) {
+            map.add(prefix + std::to_string(i), i);
+        }
+        std::string query = prefix + "42";
+        const char *c_query = query.c_str();
+        std::string_view view_query = query;
+        const Map &const_map = map;
+
+        int before = allocations;
+        CHECK(map.contains(c_query));
+        CHECK(map.contains(view_query));
+        CHECK_FALSE(map.contains(std::string_view(prefix)));
+        CHECK_EQ(42, map.get(view_query));
+        CHECK_EQ(42, const_map.get(c_query));
+        map.get(c_query) = 4200;
+        CHECK_EQ(4200, map.remove(view_query));
+        CHECK_FALSE(map.contains(view_query));
+        CHECK_EQ(before, allocations);
+
+        CHECK_THROWS_AS(map.get(view_query), key_not_found);
+        CHECK_EQ(99, map.size());
+        CHECK_FALSE(map.contains(query));
+    }
+    TEST_CASE("test only transparent maps take other key types") {
+        static_assert(is_transparent<hasher<std::string>>::value);
+        static_assert(!is_transparent<hasher<int>>::value);
+        static_assert(is_transparent<std::equal_to<>>::value);
+
+        // a non transparent map still converts to the key type first
+        Hashmap<std::string, int, hasher<std::string>,
+                std::equal_to<std::string>>
+            map;
+        map.add("key", 1);
+        CHECK(map.contains("key"));
+        CHECK_EQ(1, map.get(std::string("key")));
+    }
+}
+
+TEST_SUITE("cached hash") {
+    TEST_CASE("test resize reuses cached hashes") {
+        counting_map<true> cached;
+        counting_map<false> uncached;
+        for (int i = 0; i < 1000; ++i) {
+            cached.add(i, i);
+            uncached.add(i, i);
+        }
+
+        counting_hash::calls = 0;
+        cached.max_load_factor(0.1f);
+        CHECK_EQ(0, counting_hash::calls);
+        uncached.max_load_factor(0.1f);
+        CHECK_EQ(1000, counting_hash::calls);
+
+        for (int i = 0; i < 1000; ++i) {
+            REQUIRE_EQ(i, cached.get(i));
+        }
+    }
+    TEST_CASE("test chain walk compares hashes first") {
+        counting_map<true> cached;
+        counting_map<false> uncached;
+        // long chains, so most nodes on a walk hold another key
+        cached.max_load_factor(16.0f);
+        uncached.max_load_factor(16.0f);
+        for (int i = 0; i < 1000; ++i) {
+            cached.add(i, i);
+            uncached.add(i, i);
+        }
+
+        counting_equal::calls = 0;
+        for (int i = 0; i < 1000; ++i) {
+            REQUIRE_EQ(i, cached.get(i));
+        }
+        CHECK_FALSE(cached.contains(1000));
+        CHECK_EQ(1000, counting_equal::calls);
+
+        counting_equal::calls = 0;
+        for (int i = 0; i < 1000; ++i) {
+            REQUIRE_EQ(i, uncached.get(i));
+        }
+        CHECK_GT(counting_equal::calls, 2000);
+    }
+    TEST_CASE("test copy keeps cached hashes") {
+        counting_map<true> map;
+        for (int i = 0; i < 100; ++i) {
+            map.add(i, i);
+        }
+
+        counting_hash::calls = 0;
+        counting_map<true> copy(map);
+        counting_map<true> assigned;
+        assigned = map;
+        CHECK(copy == map);
+        CHECK(assigned == map);
+        for (int i = 0; i < 90; ++i) {
+            copy.remove(i);
+        }
+        CHECK(copy.optimize());
+        CHECK_EQ(90, counting_hash::calls);
+
+        for (int i = 90; i < 100; ++i) {
+            REQUIRE_EQ(i, copy.get(i));
+        }
+    }
+}
+
+TEST_SUITE("iterators") {
+    static_assert(std::forward_iterator<gimap::iterator>);
+    static_assert(std::forward_iterator<gfmap::const_iterator>);
+    static_assert(std::ranges::forward_range<gsmap>);
+    static_assert(std::ranges::forward_range<const gimap>);
+    static_assert(
+        std::is_convertible_v<gsmap::iterator, gsmap::const_iterator>);
+    static_assert(
+        !std::is_convertible_v<gsmap::const_iterator, gsmap::iterator>);
+
+    TEST_CASE_TEMPLATE("test empty map iteration", Storage, chained_storage<>,
+                       flat_storage, swiss_storage) {
+        Hashmap<int, gint, hasher<int>, std::equal_to<>, Storage> map;
+        CHECK(map.begin() == map.end());
+        CHECK(map.cbegin() == map.cend());
+        for (auto entry : map) {
+            FAIL("visited " << entry.key);
+        }
+    }
+    TEST_CASE_TEMPLATE("test range for visits every item once", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        gint::init();
+        Hashmap<int, gint, hasher<int>, std::equal_to<>, Storage> map;
+        for (int i = 0; i < 1000; ++i) {
+            map.add(i, i * 2);
+        }
+        gint::changes();
+
+        std::vector<bool> seen(1000, false);
+        for (auto entry : map) {
+            REQUIRE_FALSE(seen[entry.key]);
+            REQUIRE_EQ(entry.key * 2, entry.data);
+            seen[entry.key] = true;
+        }
+        CHECK(std::all_of(seen.begin(), seen.end(), [](bool s) { return s; }));
+
+        // walking the map never copies a value
+        auto changes = gint::changes();
+        CHECK_EQ(0, changes.increments);
+        CHECK_EQ(0, changes.decrements);
+    }
+    TEST_CASE_TEMPLATE("test iterators write through", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        Hashmap<int, int, hasher<int>, std::equal_to<>, Storage> map;
+        for (int i = 0; i < 100; ++i) {
+            map.add(i, i);
+        }
+        for (auto it = map.begin(); it != map.end(); ++it) {
+            it->data += 1000;
+        }
+        for (auto entry : map) {
+            entry.data *= 2;
+        }
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE_EQ((i + 1000) * 2, map.get(i));
+        }
+    }
+    TEST_CASE_TEMPLATE("test iteration skips removed items", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        Hashmap<int, int, hasher<int>, std::equal_to<>, Storage> map;
+        for (int i = 0; i < 10000; ++i) {
+            map.add(i, i);
+        }
+        for (int i = 0; i < 10000; ++i) {
+            if (i % 1000 != 0) {
+                map.remove(i);
+            }
+        }
+
+        std::vector<int> keys;
+        for (auto entry : map) {
+            keys.push_back(entry.key);
+        }
+        std::sort(keys.begin(), keys.end());
+        CHECK_EQ(std::vector<int>{0, 1000, 2000, 3000, 4000, 5000, 6000,
+                                  7000, 8000, 9000},
+                 keys);
+    }
+    TEST_CASE_TEMPLATE("test iterators with algorithms and ranges", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        using Map = Hashmap<int, int, hasher<int>, std::equal_to<>, Storage>;
+        Map map;
+        for (int i = 0; i < 100; ++i) {
+            map.add(i, i % 10);
+        }
+        const Map &const_map = map;
+
+        CHECK_EQ(100, std::distance(map.begin(), map.end()));
+        CHECK_EQ(100, std::ranges::distance(const_map));
+        CHECK_EQ(10, std::count_if(map.begin(), map.end(), [](auto entry) {
+                     return entry.data == 3;
+                 }));
+
+        auto found = std::ranges::find_if(
+            const_map, [](auto entry) { return entry.key == 42; });
+        REQUIRE(found != const_map.end());
+        CHECK_EQ(2, found->data);
+
+        auto keys = map | std::views::filter([](auto entry) {
+                        return entry.data == 0;
+                    }) |
+                    std::views::transform([](auto entry) { return entry.key; });
+        int sum = 0;
+        for (int key : keys) {
+            sum += key;
+        }
+        CHECK_EQ(450, sum);
+
+        typename Map::const_iterator it = map.begin();
+        auto old = it++;
+        CHECK(old == const_map.begin());
+        CHECK(it != old);
+    }
+}
+
+TEST_SUITE("in place insertion") {
+    TEST_CASE_TEMPLATE("test each insert makes the value once", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        Hashmap<int, gint, identity_hash, std::equal_to<>, Storage> map;
+        gint::init();
+
+        auto [it, added] = map.emplace(1, 10);
+        CHECK(added);
+        CHECK_EQ(1, it->key);
+        CHECK_EQ(10, it->data);
+        CHECK_EQ(1, gint::changes().increments);
+
+        CHECK(map.try_emplace(2, 20).second);
+        CHECK_EQ(1, gint::changes().increments);
+
+        CHECK(map.insert_or_assign(3, 30).second);
+        CHECK_EQ(1, gint::changes().increments);
+
+        gint value(40);
+        gint::changes();
+        CHECK(map.add(4, std::move(value)));
+        CHECK_EQ(1, gint::changes().increments);
+
+        map.put(5, gint(50));
+        auto changes = gint::changes();
+        CHECK_EQ(2, changes.increments); // the temporary and the stored value
+        CHECK_EQ(1, changes.decrements);
+
+        for (int i = 1; i <= 5; ++i) {
+            REQUIRE_EQ(i * 10, map.get(i));
+        }
+        CHECK_EQ(6, gint::count()); // five items and the moved from value
+    }
+    TEST_CASE_TEMPLATE("test existing keys are not made again", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        Hashmap<int, gint, identity_hash, std::equal_to<>, Storage> map;
+        map.add(1, 10);
+        gint::init();
+
+        auto [it, added] = map.try_emplace(1, 99);
+        CHECK_FALSE(added);
+        CHECK_EQ(10, it->data);
+        CHECK_FALSE(map.emplace(1, 99).second);
+        CHECK_EQ(0, gint::changes().increments);
+
+        auto assigned = map.insert_or_assign(1, 11);
+        CHECK_FALSE(assigned.second);
+        CHECK_EQ(11, assigned.first->data);
+        CHECK_EQ(11, map.get(1));
+        CHECK_EQ(1, map.size());
+    }
+    TEST_CASE_TEMPLATE("test try_emplace leaves an rvalue alone", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        Hashmap<std::string, std::unique_ptr<int>, hasher<std::string>,
+                std::equal_to<>, Storage>
+            map;
+        auto owned = std::make_unique<int>(1);
+        CHECK(map.try_emplace("one", std::move(owned)).second);
+        CHECK(owned == nullptr);
+
+        owned = std::make_unique<int>(2);
+        CHECK_FALSE(map.try_emplace("one", std::move(owned)).second);
+        REQUIRE(owned != nullptr);
+        CHECK_EQ(1, *map.get("one"));
+
+        map.insert_or_assign("one", std::move(owned));
+        CHECK_EQ(2, *map.get("one"));
+
+        std::string key = "two";
+        map.try_emplace(std::move(key), new int(3));
+        CHECK_EQ(3, *map.get("two"));
+    }
+    TEST_CASE_TEMPLATE("test an insert compares each colliding key once",
+                       Storage, chained_storage<>, flat_storage,
+                       swiss_storage) {
+        Hashmap<int, int, constant_hash, counting_equal, Storage> map;
+        counting_equal::calls = 0;
+        for (int i = 0; i < 50; ++i) {
+            REQUIRE(map.try_emplace(i, i).second);
+        }
+        // the i-th key only meets the i keys before it, growth compares none
+        CHECK_EQ(50 * 49 / 2, counting_equal::calls);
+
+        counting_equal::calls = 0;
+        auto [it, added] = map.try_emplace(49, -1);
+        CHECK_FALSE(added);
+        CHECK_EQ(49, it->data);
+        CHECK_LE(counting_equal::calls, 50);
+        for (int i = 0; i < 50; ++i) {
+            REQUIRE_EQ(i, map.get(i));
+        }
+    }
+    TEST_CASE_TEMPLATE("test emplace keeps every item through growth",
+                       Storage, chained_storage<>, flat_storage,
+                       swiss_storage) {
+        gint::init();
+        {
+            Hashmap<int, gint, hasher<int>, std::equal_to<>, Storage> map;
+            for (int i = 0; i < 1000; ++i) {
+                auto [it, added] = map.emplace(i, i * 2);
+                REQUIRE(added);
+                REQUIRE_EQ(i, it->key);
+                REQUIRE_EQ(i * 2, it->data);
+            }
+            for (int i = 0; i < 1000; i += 2) {
+                map.remove(i);
+            }
+            for (int i = 0; i < 1000; ++i) {
+                REQUIRE_EQ(i % 2 == 1, map.contains(i));
+                map.try_emplace(i, i * 2);
+            }
+            for (int i = 0; i < 1000; ++i) {
+                REQUIRE_EQ(i * 2, map.get(i));
+            }
+            CHECK_EQ(1000, gint::count());
+        }
+        CHECK_EQ(0, gint::count());
+    }
+}
+
+TEST_SUITE("non-throwing lookups") {
+    TEST_CASE_TEMPLATE("test find, try_get, get_or and erase", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        using Map = Hashmap<int, int, hasher<int>, std::equal_to<>, Storage>;
+        Map map;
+        for (int i = 0; i < 100; ++i) {
+            map.add(i, i * 2);
+        }
+        const Map &const_map = map;
+
+        auto found = map.find(42);
+        REQUIRE(found != map.end());
+        CHECK_EQ(42, found->key);
+        CHECK_EQ(84, found->data);
+        found->data = 1;
+        CHECK_EQ(1, map.get(42));
+        CHECK(map.find(100) == map.end());
+        CHECK(const_map.find(7) != const_map.end());
+        CHECK(const_map.find(-7) == const_map.end());
+
+        REQUIRE(map.try_get(5) != nullptr);
+        *map.try_get(5) = 50;
+        CHECK_EQ(50, *const_map.try_get(5));
+        CHECK(map.try_get(500) == nullptr);
+        CHECK(const_map.try_get(500) == nullptr);
+
+        CHECK_EQ(50, map.get_or(5, -1));
+        CHECK_EQ(-1, map.get_or(500, -1));
+
+        CHECK_EQ(1, map.erase(5));
+        CHECK_EQ(0, map.erase(5));
+        CHECK_EQ(0, map.erase(500));
+        CHECK_EQ(99, map.size());
+        CHECK_FALSE(map.contains(5));
+        CHECK_EQ(-1, map.get_or(5, -1));
+    }
+    TEST_CASE_TEMPLATE("test erase keeps colliding items reachable", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        Hashmap<int, int, constant_hash, std::equal_to<>, Storage> map;
+        for (int i = 0; i < 20; ++i) {
+            map.add(i, i);
+        }
+        // the head, the middle and the tail of the same chain or run
+        CHECK_EQ(1, map.erase(0));
+        CHECK_EQ(1, map.erase(10));
+        CHECK_EQ(1, map.erase(19));
+        CHECK_EQ(0, map.erase(19));
+        for (int i = 0; i < 20; ++i) {
+            bool kept = i != 0 && i != 10 && i != 19;
+            REQUIRE_EQ(kept, map.find(i) != map.end());
+            REQUIRE_EQ(kept ? i : -1, map.get_or(i, -1));
+        }
+    }
+    TEST_CASE_TEMPLATE("test string misses neither throw nor allocate",
+                       Storage, chained_storage<>, flat_storage,
+                       swiss_storage) {
+        Hashmap<std::string, int, hasher<std::string>, std::equal_to<>,
+                Storage>
+            map;
+        std::string long_key(40, 'k');
+        map.add(long_key, 1);
+        std::string_view missing = "no such key, long enough not to be inline";
+
+        int before = allocations;
+        CHECK(map.find(missing) == map.end());
+        CHECK(map.try_get(missing) == nullptr);
+        CHECK_EQ(7, map.get_or(missing, 7));
+        CHECK_EQ(0, map.erase(missing));
+        CHECK_EQ(1, map.get_or(std::string_view(long_key), 7));
+        CHECK(map.try_get(long_key.c_str()) != nullptr);
+        CHECK_EQ(before, allocations);
+
+        CHECK_EQ(1, map.erase(std::string_view(long_key)));
+        CHECK_EQ(0, map.size());
+    }
+}
+
+TEST_SUITE("remove and extract") {
+    TEST_CASE_TEMPLATE("test remove a missing key from a full bucket",
+                       Storage, chained_storage<>, flat_storage,
+                       swiss_storage) {
+        Hashmap<int, int, constant_hash, std::equal_to<>, Storage> map;
+        for (int i = 0; i < 5; ++i) {
+            map.add(i, i);
+        }
+        // every key shares the bucket, so the whole chain or run is walked
+        CHECK_THROWS_AS(map.remove(5), key_not_found);
+        CHECK_EQ(0, map.erase(5));
+        CHECK_EQ(4, map.remove(4));
+        CHECK_EQ(0, map.remove(0));
+        CHECK_THROWS_AS(map.remove(0), key_not_found);
+        CHECK_EQ(3, map.size());
+        for (int i = 1; i < 4; ++i) {
+            REQUIRE_EQ(i, map.get(i));
+        }
+    }
+    TEST_CASE_TEMPLATE("test remove moves the value out", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        Hashmap<int, std::unique_ptr<int>, hasher<int>, std::equal_to<>,
+                Storage>
+            map;
+        map.try_emplace(1, new int(7));
+        std::unique_ptr<int> removed = map.remove(1);
+        REQUIRE(removed != nullptr);
+        CHECK_EQ(7, *removed);
+        CHECK_EQ(0, map.size());
+    }
+    TEST_CASE("test extract and insert move nodes between maps") {
+        using Map = Hashmap<int, gint, hasher<int>, std::equal_to<>,
+                            chained_storage<>,
+                            CountingAllocator<std::pair<const int, gint>>>;
+        gint::init();
+        {
+            Map from;
+            Map to;
+            for (int i = 0; i < 10; ++i) {
+                from.add(i, i * 10);
+            }
+            const gint *address = &from.get(3);
+            int blocks = liveBlocks<int, gint, chained_storage<>>();
+            gint::changes();
+
+            Map::node_type node = from.extract(3);
+            REQUIRE_FALSE(node.empty());
+            CHECK_EQ(3, node.key());
+            CHECK_EQ(30, node.data());
+            CHECK_FALSE(from.contains(3));
+            CHECK_EQ(9, from.size());
+
+            auto [it, inserted] = to.insert(std::move(node));
+            CHECK(inserted);
+            CHECK(node.empty());
+            CHECK_EQ(3, it->key);
+            CHECK_EQ(address, &it->data);
+            CHECK_EQ(address, &to.get(3));
+
+            // nothing was made, copied or freed on the way
+            auto changes = gint::changes();
+            CHECK_EQ(0, changes.increments);
+            CHECK_EQ(0, changes.decrements);
+            CHECK_EQ(blocks, liveBlocks<int, gint, chained_storage<>>());
+        }
+        CHECK_EQ(0, gint::count());
+    }
+    TEST_CASE("test node handles that do not go in") {
+        gint::init();
+        gimap map;
+        for (int i = 0; i < 10; ++i) {
+            map.add(i, i);
+        }
+
+        gimap::node_type missing = map.extract(42);
+        CHECK(missing.empty());
+        CHECK_FALSE(map.insert(std::move(missing)).second);
+
+        // the key is taken, so the handle keeps its node
+        gimap::node_type node = map.extract(1);
+        map.add(1, 100);
+        auto [it, inserted] = map.insert(std::move(node));
+        CHECK_FALSE(inserted);
+        CHECK_EQ(100, it->data);
+        REQUIRE(node);
+        CHECK_EQ(1, node.data());
+
+        // until its key is changed
+        node.key() = 11;
+        CHECK(map.insert(std::move(node)).second);
+        CHECK_EQ(1, map.get(11));
+        CHECK_EQ(11, map.size());
+
+        node = map.extract(5);
+        CHECK_EQ(11, gint::count());
+        node = gimap::node_type();
+        CHECK_EQ(10, gint::count());
+        map.extract(6);
+        CHECK_EQ(9, gint::count());
+        CHECK_EQ(9, map.size());
+    }
+    TEST_CASE("test extract keeps cached hashes right") {
+        Hashmap<std::string, int, hasher<std::string>, std::equal_to<>,
+                chained_storage<pow2_buckets, true>>
+            map;
+        for (int i = 0; i < 100; ++i) {
+            map.add(std::to_string(i), i);
+        }
+        auto node = map.extract("7");
+        node.key() = "seven";
+        map.insert(std::move(node));
+        CHECK_EQ(7, map.get("seven"));
+        CHECK_FALSE(map.contains("7"));
+        CHECK_EQ(100, map.size());
+    }
+    TEST_CASE("test insert from a map with another pool") {
+        gint::init();
+        {
+            gpmap from;
+            gpmap to;
+            from.add(1, 10);
+            to.add(2, 20);
+            REQUIRE(from.get_allocator() != to.get_allocator());
+
+            CHECK(to.insert(from.extract(1)).second);
+            from.clear();
+            CHECK_EQ(10, to.get(1));
+            CHECK_EQ(2, to.size());
+            CHECK_EQ(2, gint::count());
+        }
+        CHECK_EQ(0, gint::count());
+    }
+}
+
+TEST_SUITE("sizing") {
+    TEST_CASE_TEMPLATE("test reserve then add never grows", Storage,
+                       chained_storage<>, chained_storage<prime_buckets>,
+                       flat_storage, swiss_storage) {
+        Hashmap<int, gint, hasher<int>, std::equal_to<>, Storage> map;
+        map.reserve(10000);
+        size_t buckets = map.bucket_count();
+        CHECK_GE(buckets * map.max_load_factor(), 10000);
+
+        for (int i = 0; i < 10000; ++i) {
+            map.add(i, i);
+            REQUIRE_EQ(buckets, map.bucket_count());
+        }
+        CHECK_EQ(10000, map.size());
+
+        // asking for less than there is never shrinks
+        map.reserve(10);
+        CHECK_EQ(buckets, map.bucket_count());
+    }
+    TEST_CASE_TEMPLATE("test reserve after removals never grows", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        Hashmap<int, int, hasher<int>, std::equal_to<>, Storage> map;
+        for (int i = 0; i < 1000; ++i) {
+            map.add(i, i);
+        }
+        for (int i = 0; i < 1000; i += 3) {
+            map.remove(i);
+        }
+        map.reserve(2000);
+        size_t buckets = map.bucket_count();
+        for (int i = 1000; map.size() < 2000; ++i) {
+            map.add(i, i);
+            REQUIRE_EQ(buckets, map.bucket_count());
+        }
+    }
+    TEST_CASE_TEMPLATE("test bucket count constructor", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        using Map = Hashmap<int, int, hasher<int>, std::equal_to<>, Storage>;
+        Map map(1000);
+        size_t buckets = map.bucket_count();
+        CHECK_GE(buckets, 1000);
+        size_t fits = static_cast<size_t>(buckets * map.max_load_factor());
+        for (size_t i = 0; i < fits; ++i) {
+            map.add(static_cast<int>(i), 0);
+        }
+        CHECK_EQ(buckets, map.bucket_count());
+        map.add(-1, 0);
+        CHECK_GT(map.bucket_count(), buckets);
+
+        Map tiny(1);
+        for (int i = 0; i < 100; ++i) {
+            tiny.add(i, i);
+        }
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE_EQ(i, tiny.get(i));
+        }
+    }
+    TEST_CASE_TEMPLATE("test rehash", Storage, chained_storage<>,
+                       flat_storage, swiss_storage) {
+        Hashmap<int, int, hasher<int>, std::equal_to<>, Storage> map;
+        for (int i = 0; i < 100; ++i) {
+            map.add(i, i);
+        }
+        map.rehash(5000);
+        CHECK_GE(map.bucket_count(), 5000);
+
+        // shrinking stops at what the items need
+        map.rehash(0);
+        CHECK_LT(map.bucket_count(), 5000);
+        CHECK_GE(map.bucket_count() * map.max_load_factor(), 100);
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE_EQ(i, map.get(i));
+        }
+    }
+    TEST_CASE("test bucket count constructor with an allocator") {
+        gint::init();
+        PoolAllocator<std::pair<const int, gint>> pool;
+        {
+            gpmap map(64, pool);
+            CHECK_EQ(64, map.bucket_count());
+            CHECK(map.get_allocator() == pool);
+            map.add(1, 1);
+        }
+        CHECK_EQ(0, gint::count());
+    }
+}
+
+TEST_SUITE("shrink to fit") {
+    TEST_CASE_TEMPLATE("test shrink to fit after removals", Storage,
+                       chained_storage<>, chained_storage<prime_buckets>,
+                       flat_storage, swiss_storage) {
+        gint::init();
+        Hashmap<int, gint, hasher<int>, std::equal_to<>, Storage> map;
+        for (int i = 0; i < 10000; ++i) {
+            map.add(i, i);
+        }
+        size_t full = map.bucket_count();
+        for (int i = 100; i < 10000; ++i) {
+            map.remove(i);
+        }
+        CHECK_EQ(full, map.bucket_count());
+
+        map.shrink_to_fit();
+        size_t fitted = map.bucket_count();
+        CHECK_LT(fitted, full);
+        CHECK_GE(fitted * map.max_load_factor(), 100);
+        // the next size down would be over the max load factor
+        CHECK_LT(fitted / 2 * map.max_load_factor(), 100);
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE_EQ(i, map.get(i));
+        }
+        CHECK_EQ(100, gint::count());
+
+        // already fitted, nothing to free
+        map.shrink_to_fit();
+        CHECK_EQ(fitted, map.bucket_count());
+        CHECK_FALSE(map.optimize());
+    }
+    TEST_CASE_TEMPLATE("test shrink to fit follows the max load factor",
+                       Storage, chained_storage<>, flat_storage,
+                       swiss_storage) {
+        Hashmap<int, int, hasher<int>, std::equal_to<>, Storage> map;
+        map.rehash(1 << 14);
+        for (int i = 0; i < 1000; ++i) {
+            map.add(i, i);
+        }
+        map.max_load_factor(0.5f);
+        map.shrink_to_fit();
+        CHECK_EQ(2048, map.bucket_count());
+        CHECK(map.load_factor() <= 0.5f);
+    }
+}
+
+TEST_SUITE("bulk insert") {
+    TEST_CASE_TEMPLATE("test range constructor sizes the map once", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        using Map = Hashmap<int, gint, hasher<int>, std::equal_to<>, Storage>;
+        gint::init();
+        std::vector<std::pair<int, gint>> items;
+        for (int i = 0; i < 1000; ++i) {
+            items.emplace_back(i, i * 2);
+        }
+
+        Map map(items.begin(), items.end());
+        CHECK_EQ(1000, map.size());
+        CHECK_EQ(2000, gint::count());
+        for (int i = 0; i < 1000; ++i) {
+            REQUIRE_EQ(i * 2, map.get(i));
+        }
+
+        Map reserved;
+        reserved.reserve(1000);
+        CHECK_EQ(reserved.bucket_count(), map.bucket_count());
+    }
+    TEST_CASE_TEMPLATE("test insert keeps the first of each key", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        using Map = Hashmap<int, int, hasher<int>, std::equal_to<>, Storage>;
+        std::vector<std::pair<int, int>> items = {
+            {1, 10}, {2, 20}, {1, 11}, {3, 30}, {2, 21}};
+        Map map(items.begin(), items.end());
+        CHECK_EQ(3, map.size());
+        CHECK_EQ(10, map.get(1));
+        CHECK_EQ(20, map.get(2));
+
+        std::vector<std::pair<int, int>> more = {{3, 31}, {4, 40}};
+        map.insert(more.begin(), more.end());
+        CHECK_EQ(4, map.size());
+        CHECK_EQ(30, map.get(3));
+        CHECK_EQ(40, map.get(4));
+    }
+    TEST_CASE_TEMPLATE("test insert range", Storage, chained_storage<>,
+                       flat_storage, swiss_storage) {
+        using Map = Hashmap<int, int, hasher<int>, std::equal_to<>, Storage>;
+        Map map;
+        map.insert_range(std::views::iota(0, 500) |
+                         std::views::transform([](int i) {
+                             return std::pair<int, int>(i, i + 1);
+                         }));
+        CHECK_EQ(500, map.size());
+        CHECK_EQ(43, map.get(42));
+
+        // another map's entries work as items too
+        Map copy(map.begin(), map.end());
+        CHECK(copy == map);
+        Map other;
+        other.insert_range(map);
+        CHECK(other == map);
+
+        // an input only range cannot be counted, it still goes in
+        std::istringstream numbers("1 2 3 4 5");
+        Map from_stream;
+        from_stream.insert_range(std::views::istream<int>(numbers) |
+                                 std::views::transform([](int i) {
+                                     return std::pair<int, int>(i, -i);
+                                 }));
+        CHECK_EQ(5, from_stream.size());
+        CHECK_EQ(-4, from_stream.get(4));
+    }
+    TEST_CASE_TEMPLATE("test bulk insert converts and moves", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        Hashmap<std::string, std::unique_ptr<int>, hasher<std::string>,
+                std::equal_to<>, Storage>
+            map;
+        std::vector<std::pair<const char *, std::unique_ptr<int>>> items;
+        items.emplace_back("one", new int(1));
+        items.emplace_back("two", new int(2));
+        map.insert(std::make_move_iterator(items.begin()),
+                   std::make_move_iterator(items.end()));
+        CHECK_EQ(2, map.size());
+        CHECK_EQ(2, *map.get("two"));
+        CHECK(items[0].second == nullptr);
+    }
+}
+
+TEST_SUITE("merge") {
+    TEST_CASE("test merge from another allocator keeps both maps whole when "
+              "a copy throws") {
+        using Map = Hashmap<int, Brittle, hasher<int>, std::equal_to<>,
+                            chained_storage<>,
+                            PoolAllocator<std::pair<const int, Brittle>>>;
+        // each map gets its own arena, so nodes cannot be handed over
+        Map map;
+        Map other;
+        for (int i = 0; i < 10; ++i) {
+            other.add(i, Brittle(i));
+        }
+        REQUIRE(map.get_allocator() != other.get_allocator());
+
+        Brittle::copies_left = 4;
+        CHECK_THROWS_AS(map.merge(std::move(other)), std::runtime_error);
+        Brittle::copies_left = -1;
+        CHECK_EQ(10, map.size() + other.size());
+        CHECK_EQ(other.size(), std::distance(other.begin(), other.end()));
+        for (int i = 0; i < 10; ++i) {
+            REQUIRE_NE(map.contains(i), other.contains(i));
+            CHECK_EQ(i, (map.contains(i) ? map : other).get(i).value);
+        }
+    }
+
+    TEST_CASE_TEMPLATE("test merge a copy", Storage, chained_storage<>,
+                       flat_storage, swiss_storage) {
+        using Map = Hashmap<int, int, hasher<int>, std::equal_to<>, Storage>;
+        Map map;
+        Map other;
+        for (int i = 0; i < 1000; ++i) {
+            map.add(i, i);
+            other.add(i + 500, -i);
+        }
+        map.merge(other);
+        CHECK_EQ(1500, map.size());
+        CHECK_EQ(1000, other.size());
+        // the map keeps its own item on a clash, like add
+        CHECK_EQ(700, map.get(700));
+        CHECK_EQ(-999, map.get(1499));
+
+        Map reserved;
+        reserved.reserve(2000);
+        CHECK_EQ(reserved.bucket_count(), map.bucket_count());
+
+        map.merge(map);
+        CHECK_EQ(1500, map.size());
+    }
+    TEST_CASE_TEMPLATE("test merge an rvalue leaves the clashes", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        using Map = Hashmap<int, gint, hasher<int>, std::equal_to<>, Storage>;
+        gint::init();
+        {
+            Map map;
+            Map other;
+            for (int i = 0; i < 1000; ++i) {
+                map.add(i, i);
+                other.add(i + 900, -i);
+            }
+            map.merge(std::move(other));
+            CHECK_EQ(1900, map.size());
+            CHECK_EQ(-999, map.get(1899));
+            CHECK_EQ(900, map.get(900));
+
+            REQUIRE_EQ(100, other.size());
+            for (int i = 900; i < 1000; ++i) {
+                REQUIRE_EQ(900 - i, other.get(i));
+            }
+            CHECK_EQ(2000, gint::count());
+        }
+        CHECK_EQ(0, gint::count());
+    }
+    TEST_CASE("test merge an rvalue relinks nodes") {
+        gint::init();
+        gimap map;
+        gimap other;
+        for (int i = 0; i < 100; ++i) {
+            other.add(i, i);
+        }
+        const gint *address = &other.get(42);
+        gint::changes();
+
+        map.merge(std::move(other));
+        auto changes = gint::changes();
+        CHECK_EQ(0, changes.increments);
+        CHECK_EQ(0, changes.decrements);
+        CHECK_EQ(address, &map.get(42));
+        CHECK_EQ(0, other.size());
+        CHECK(other.begin() == other.end());
+    }
+    TEST_CASE("test merge reuses cached hashes") {
+        counting_map<true> map;
+        counting_map<true> other;
+        counting_map<true> moved;
+        for (int i = 0; i < 1000; ++i) {
+            other.add(i, i);
+            moved.add(i + 1000, i);
+        }
+        counting_hash::calls = 0;
+        map.merge(other);
+        map.merge(std::move(moved));
+        CHECK_EQ(0, counting_hash::calls);
+        CHECK_EQ(2000, map.size());
+        CHECK_EQ(5, map.get(1005));
+
+        // without a cache every key is hashed
+        counting_map<false> uncached;
+        counting_map<false> source;
+        for (int i = 0; i < 100; ++i) {
+            source.add(i, i);
+        }
+        counting_hash::calls = 0;
+        uncached.merge(source);
+        CHECK_GE(counting_hash::calls, 100);
+    }
+    TEST_CASE("test merge an rvalue across pools") {
+        gint::init();
+        {
+            gpmap map;
+            gpmap other;
+            map.add(1, 1);
+            other.add(1, -1);
+            other.add(2, 2);
+            map.merge(std::move(other));
+            CHECK_EQ(2, map.size());
+            CHECK_EQ(1, map.get(1));
+            CHECK_EQ(2, map.get(2));
+            CHECK_EQ(1, other.size());
+            CHECK_EQ(-1, other.get(1));
+            other.clear();
+            CHECK_EQ(2, map.get(2));
+        }
+        CHECK_EQ(0, gint::count());
+    }
+}
+
+TEST_SUITE("structural copy") {
+    TEST_CASE_TEMPLATE("test copy frees what it built when an item throws",
+                       Storage, chained_storage<>, flat_storage,
+                       swiss_storage) {
+        using Map =
+            Hashmap<int, Brittle, hasher<int>, std::equal_to<>, Storage>;
+        gint::init();
+        {
+            Map map;
+            for (int i = 0; i < 100; ++i) {
+                map.add(i, Brittle(i));
+            }
+            REQUIRE_EQ(100, gint::count());
+
+            Brittle::copies_left = 50;
+            CHECK_THROWS_AS(Map copy(map), std::runtime_error);
+            CHECK_EQ(100, gint::count());
+            Brittle::copies_left = -1;
+
+            Map assigned;
+            assigned.add(1000, Brittle(1000));
+            Brittle::copies_left = 50;
+            CHECK_THROWS_AS(assigned = map, std::runtime_error);
+            Brittle::copies_left = -1;
+            CHECK_EQ(100, gint::count());
+        }
+        CHECK_EQ(0, gint::count());
+    }
+
+    /// @brief the keys in the order the map walks them
+    template <typename Map> std::vector<int> walk(const Map &map) {
+        std::vector<int> keys;
+        for (auto entry : map) {
+            keys.push_back(entry.key);
+        }
+        return keys;
+    }
+
+    TEST_CASE("test copy keeps the bucket layout") {
+        gimap map(1024);
+        for (int i = 0; i < 300; ++i) {
+            map.add(i * 7, gint(i));
+        }
+        for (int i = 0; i < 300; i += 3) {
+            map.remove(i * 7);
+        }
+        gimap copy(map);
+        CHECK_EQ(map.bucket_count(), copy.bucket_count());
+        CHECK_EQ(walk(map), walk(copy));
+        CHECK(copy == map);
+
+        gimap assigned;
+        assigned.add(-1, gint(-1));
+        assigned = map;
+        CHECK_EQ(map.bucket_count(), assigned.bucket_count());
+        CHECK_EQ(walk(map), walk(assigned));
+        CHECK_FALSE(assigned.contains(-1));
+    }
+
+    TEST_CASE("test copy makes its nodes in one allocation") {
+        using Map = Hashmap<int, int, hasher<int>, std::equal_to<>,
+                            chained_storage<>,
+                            CountingAllocator<std::pair<const int, int>>>;
+        {
+            Map map;
+            for (int i = 0; i < 100; ++i) {
+                map.add(i, i);
+            }
+            int blocks = liveBlocks<int, int, chained_storage<>>();
+            Map copy(map);
+            // the buckets and the nodes
+            CHECK_EQ(blocks + 2, liveBlocks<int, int, chained_storage<>>());
+            copy.remove(1);
+            CHECK_EQ(blocks + 2, liveBlocks<int, int, chained_storage<>>());
+            copy.add(1, 1);
+            CHECK_EQ(blocks + 3, liveBlocks<int, int, chained_storage<>>());
+            copy.clear();
+            CHECK_EQ(blocks + 1, liveBlocks<int, int, chained_storage<>>());
+        }
+        CHECK_EQ(0, liveBlocks<int, int, chained_storage<>>());
+    }
+
+    TEST_CASE("test copy frees what it took when an allocation throws") {
+        using Map = Hashmap<int, int, hasher<int>, std::equal_to<>,
+                            chained_storage<>,
+                            CountingAllocator<std::pair<const int, int>>>;
+        {
+            Map map;
+            // old buckets as well, copied in the middle of a grow
+            for (int i = 0; i < 17; ++i) {
+                map.add(i, i);
+            }
+            int blocks = liveBlocks<int, int, chained_storage<>>();
+            // the buckets, the old buckets and then the nodes
+            for (int left = 0; left < 3; ++left) {
+                allocations_left = left;
+                CHECK_THROWS_AS(Map{map}, std::bad_alloc);
+                allocations_left = -1;
+                CHECK_EQ(blocks, liveBlocks<int, int, chained_storage<>>());
+            }
+            Map copy(map);
+            CHECK(copy == map);
+        }
+        CHECK_EQ(0, liveBlocks<int, int, chained_storage<>>());
+    }
+
+    TEST_CASE("test extract keeps the item when its node cannot be copied") {
+        gint::init();
+        {
+            Hashmap<int, Brittle> map;
+            for (int i = 0; i < 20; ++i) {
+                map.add(i, i);
+            }
+            Hashmap<int, Brittle> copy(map);
+            Brittle::copies_left = 0;
+            CHECK_THROWS_AS(copy.extract(3), std::runtime_error);
+            Brittle::copies_left = -1;
+            CHECK_EQ(20, copy.size());
+            CHECK_EQ(3, copy.get(3).value);
+            auto node = copy.extract(3);
+            REQUIRE(node);
+            CHECK_EQ(3, node.data().value);
+            CHECK_FALSE(copy.contains(3));
+        }
+        CHECK_EQ(0, gint::count());
+    }
+
+    TEST_CASE("test nodes of a copy leave it safely") {
+        gint::init();
+        {
+            gimap map;
+            for (int i = 0; i < 20; ++i) {
+                map.add(i, gint(i));
+            }
+            gimap copy(map);
+            auto node = copy.extract(3);
+            REQUIRE(node);
+            CHECK_EQ(3, node.data());
+
+            gimap other;
+            other.merge(std::move(copy));
+            CHECK_EQ(0, copy.size());
+            copy.clear();
+            CHECK_EQ(19, other.size());
+            CHECK_EQ(7, other.get(7));
+            CHECK(other.insert(std::move(node)).second);
+
+            gimap moved(std::move(map));
+            gimap copied(moved);
+            gimap target;
+            target = std::move(copied);
+            CHECK_EQ(20, target.size());
+            CHECK_EQ(12, target.get(12));
+        }
+        CHECK_EQ(0, gint::count());
+    }
+}
+
+TEST_SUITE("concurrent map") {
+    TEST_CASE("test concurrent map keeps map semantics") {
+        ConcurrentHashmap<int, int> map(10);
+        CHECK_EQ(16, map.shard_count());
+        CHECK(map.add(1, 10));
+        CHECK_FALSE(map.add(1, 11));
+        CHECK_EQ(10, map.get(1));
+        map.put(1, 12);
+        map.put(2, 20);
+        CHECK_EQ(12, map.get(1));
+        CHECK_EQ(2, map.size());
+        CHECK(map.contains(2));
+        CHECK_EQ(20, map.remove(2));
+        CHECK_FALSE(map.contains(2));
+        CHECK_THROWS_AS(map.get(2), key_not_found);
+        CHECK_THROWS_AS(map.remove(2), key_not_found);
+        map.clear();
+        CHECK_EQ(0, map.size());
+
+        ConcurrentHashmap<int, int> single(1);
+        CHECK_EQ(1, single.shard_count());
+        single.add(5, 5);
+        CHECK_EQ(5, single.get(5));
+    }
+
+    TEST_CASE("test concurrent map spreads keys over the shards") {
+        ConcurrentHashmap<int, int> map(8);
+        for (int i = 0; i < 1000; ++i) {
+            map.add(i, i);
+        }
+        CHECK_EQ(1000, map.size());
+        for (int i = 0; i < 1000; ++i) {
+            REQUIRE_EQ(i, map.get(i));
+        }
+    }
+
+    TEST_CASE_TEMPLATE("test concurrent map hashes a key once", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        ConcurrentHashmap<int, int, counting_hash, std::equal_to<>, Storage>
+            map(4);
+        counting_hash::calls = 0;
+        CHECK(map.add(1, 10));
+        map.put(1, 11);
+        CHECK_EQ(11, map.get(1));
+        CHECK(map.contains(1));
+        CHECK_EQ(11, map.remove(1));
+        CHECK_EQ(5, counting_hash::calls);
+    }
+
+    TEST_CASE_TEMPLATE("test concurrent map shards share a seeded hasher",
+                       Storage, chained_storage<>, flat_storage,
+                       swiss_storage) {
+        ConcurrentHashmap<int, int, seeded_hash, std::equal_to<>, Storage>
+            map(4);
+        // enough for every shard's map to grow and hash its keys again
+        for (int i = 0; i < 1000; ++i) {
+            map.add(i, i);
+        }
+        CHECK_EQ(1000, map.size());
+        for (int i = 0; i < 1000; ++i) {
+            REQUIRE_EQ(i, map.get(i));
+        }
+    }
+
+    TEST_CASE("test concurrent map with many threads") {
+        ConcurrentHashmap<int, int> map;
+        const int threads = 8;
+        const int per_thread = 2000;
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&map, t] {
+                for (int i = 0; i < per_thread; ++i) {
+                    int key = t * per_thread + i;
+                    map.add(key, key);
+                    // read back a key another thread may be writing
+                    map.contains((key + per_thread) % (threads * per_thread));
+                    if (i % 2 == 1) {
+                        map.remove(key);
+                    }
+                }
+            });
+        }
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+        CHECK_EQ(threads * per_thread / 2, map.size());
+        for (int key = 0; key < threads * per_thread; ++key) {
+            REQUIRE_EQ(key % 2 == 0, map.contains(key));
+        }
+    }
+}
+
+TEST_SUITE("lock-free reads") {
+    TEST_CASE("test lock-free read map keeps map semantics") {
+        LockFreeReadHashmap<int, int> map;
+        CHECK(map.add(1, 10));
+        CHECK_FALSE(map.add(1, 11));
+        CHECK_EQ(10, map.get(1));
+        map.put(1, 12);
+        map.put(2, 20);
+        CHECK_EQ(12, map.get(1));
+        CHECK_EQ(2, map.size());
+        CHECK_EQ(20, map.remove(2));
+        CHECK_FALSE(map.contains(2));
+        CHECK_THROWS_AS(map.get(2), key_not_found);
+        CHECK_THROWS_AS(map.remove(2), key_not_found);
+
+        for (int i = 0; i < 1000; ++i) {
+            map.put(i, i);
+        }
+        CHECK_EQ(1000, map.size());
+        CHECK_GE(map.bucket_count(), 1000);
+        for (int i = 0; i < 1000; ++i) {
+            REQUIRE_EQ(i, map.get(i));
+        }
+        map.clear();
+        CHECK_EQ(0, map.size());
+        CHECK_FALSE(map.contains(1));
+    }
+
+    TEST_CASE("test lock-free read map grows a few buckets at a time") {
+        LockFreeReadHashmap<int, int> map;
+        for (int i = 0; i < 17; ++i) {
+            map.add(i, i);
+        }
+        CHECK_EQ(32, map.bucket_count());
+        for (int i = 0; i < 17; ++i) {
+            REQUIRE_EQ(i, map.get(i));
+        }
+        // a helper moves the rest along
+        CHECK(map.migrate(1));
+        map.put(3, 30);
+        CHECK_EQ(2, map.remove(2));
+        CHECK_FALSE(map.migrate());
+        CHECK_FALSE(map.contains(2));
+        CHECK_EQ(30, map.get(3));
+        for (int i = 4; i < 17; ++i) {
+            REQUIRE_EQ(i, map.get(i));
+        }
+
+        // a clear in the middle of a grow drops both tables
+        for (int i = 17; i < 40; ++i) {
+            map.add(i, i);
+        }
+        map.clear();
+        CHECK_EQ(0, map.size());
+        CHECK_FALSE(map.contains(20));
+    }
+
+    TEST_CASE("test lock-free read map grow survives a throwing copy") {
+        gint::init();
+        {
+            LockFreeReadHashmap<int, Brittle> map;
+            for (int i = 0; i < 17; ++i) {
+                map.add(i, i);
+            }
+            REQUIRE_EQ(32, map.bucket_count());
+            Brittle::copies_left = 5;
+            CHECK_THROWS_AS(map.migrate(16), std::runtime_error);
+            Brittle::copies_left = -1;
+            CHECK_FALSE(map.migrate(16));
+            // a bucket copied twice would leave a key behind its remove
+            for (int i = 0; i < 17; ++i) {
+                REQUIRE_EQ(i, map.get(i).value);
+                map.remove(i);
+                REQUIRE_FALSE(map.contains(i));
+            }
+            CHECK_EQ(0, map.size());
+        }
+        drain_epochs();
+        CHECK_EQ(0, gint::count());
+    }
+
+    TEST_CASE("test epochs free what was unlinked once readers leave") {
+        gint::init();
+        drain_epochs();
+        {
+            LockFreeReadHashmap<int, gint> map;
+            for (int i = 0; i < 100; ++i) {
+                map.add(i, gint(i));
+            }
+            {
+                EpochGuard guard;
+                size_t before = EpochDomain::instance().retired_count();
+                map.remove(5);
+                map.put(6, gint(-6));
+                drain_epochs();
+                // the pinned reader may still see both old nodes
+                CHECK_EQ(before + 2, EpochDomain::instance().retired_count());
+            }
+            drain_epochs();
+            CHECK_EQ(0, EpochDomain::instance().retired_count());
+            CHECK_EQ(99, gint::count());
+            CHECK_EQ(-6, map.get(6));
+        }
+        drain_epochs();
+        CHECK_EQ(0, gint::count());
+    }
+
+    TEST_CASE("test lock-free readers alongside a writer") {
+        LockFreeReadHashmap<int, int> map;
+        const int count = 4000;
+        for (int i = 0; i < count; i += 2) {
+            map.add(i, i);
+        }
+        std::atomic<bool> done = false;
+        std::atomic<int> wrong = 0;
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 4; ++t) {
+            readers.emplace_back([&] {
+                while (!done.load()) {
+                    for (int i = 0; i < count; i += 2) {
+                        // even keys are never removed, whatever grows
+                        if (!map.contains(i) || map.get(i) % 2 != 0) {
+                            wrong++;
+                        }
+                    }
+                }
+            });
+        }
+        for (int round = 0; round < 4; ++round) {
+            for (int i = 1; i < count; i += 2) {
+                map.add(i + round * count, i);
+            }
+            for (int i = 0; i < count; i += 2) {
+                map.put(i, i + 2);
+            }
+            for (int i = 1; i < count; i += 2) {
+                map.remove(i + round * count);
+            }
+        }
+        done = true;
+        for (std::thread &reader : readers) {
+            reader.join();
+        }
+        CHECK_EQ(0, wrong.load());
+        CHECK_EQ(count / 2, map.size());
+    }
+}
+
+TEST_SUITE("incremental resize") {
+    /// @brief the keys in the order the map walks them, sorted
+    template <typename Map> std::vector<int> sorted_keys(const Map &map) {
+        std::vector<int> keys;
+        for (auto entry : map) {
+            keys.push_back(entry.key);
+        }
+        std::sort(keys.begin(), keys.end());
+        return keys;
+    }
+
+#ifdef DEBUG
+    TEST_CASE("test growing leaves items in the old buckets for later") {
+        gint::init();
+        {
+            gimap map;
+            for (int i = 0; i < 17; ++i) {
+                map.add(i, gint(i));
+            }
+            CHECK_EQ(32, map.bucket_count());
+            CHECK_EQ(16, getOldBucketCount(map));
+            for (int i = 0; i < 17; ++i) {
+                REQUIRE_EQ(i, map.get(i));
+            }
+            CHECK_EQ(17, std::distance(map.begin(), map.end()));
+            std::vector<int> expected(17);
+            std::iota(expected.begin(), expected.end(), 0);
+            CHECK_EQ(expected, sorted_keys(map));
+
+            // a find in either set of buckets walks on through the rest
+            for (int i = 0; i < 17; ++i) {
+                auto it = map.find(i);
+                REQUIRE(it != map.end());
+                CHECK_LE(std::distance(it, map.end()), 17);
+            }
+
+            // two more changes move all 16 old buckets over
+            map.add(17, gint(17));
+            CHECK_EQ(16, getOldBucketCount(map));
+            CHECK_EQ(0, map.remove(0));
+            CHECK_EQ(0, getOldBucketCount(map));
+            CHECK_EQ(17, map.size());
+            for (int i = 1; i < 18; ++i) {
+                REQUIRE_EQ(i, map.get(i));
+            }
+        }
+        CHECK_EQ(0, gint::count());
+    }
+
+    TEST_CASE("test copy, move and clear in the middle of a resize") {
+        gint::init();
+        {
+            gimap map;
+            for (int i = 0; i < 33; ++i) {
+                map.add(i, gint(i));
+            }
+            REQUIRE_NE(0, getOldBucketCount(map));
+            gimap copy(map);
+            CHECK(copy == map);
+            CHECK_EQ(getOldBucketCount(map), getOldBucketCount(copy));
+            CHECK_EQ(sorted_keys(map), sorted_keys(copy));
+
+            gimap moved(std::move(copy));
+            CHECK(moved == map);
+            gimap assigned;
+            assigned = std::move(moved);
+            CHECK(assigned == map);
+            assigned.reserve(1000);
+            CHECK_EQ(0, getOldBucketCount(assigned));
+            CHECK(assigned == map);
+
+            gimap merged;
+            merged.merge(std::move(map));
+            CHECK_EQ(33, merged.size());
+            CHECK_EQ(0, map.size());
+
+            merged.clear();
+            CHECK_EQ(0, getOldBucketCount(merged));
+            CHECK_EQ(33, assigned.size());
+        }
+        CHECK_EQ(0, gint::count());
+    }
+#endif
+
+    TEST_CASE("test random changes while growing match std::map") {
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> pick_key(0, 4999);
+        std::uniform_int_distribution<int> pick_op(0, 9);
+        Hashmap<int, int> map;
+        std::map<int, int> expected;
+        for (int step = 0; step < 40000; ++step) {
+            int key = pick_key(rng);
+            switch (pick_op(rng)) {
+            case 0:
+            case 1:
+            case 2:
+                CHECK_EQ(expected.emplace(key, step).second,
+                         map.add(key, step));
+                break;
+            case 3:
+                expected[key] = step;
+                map.put(key, step);
+                break;
+            case 4:
+            case 5:
+                CHECK_EQ(expected.erase(key), map.erase(key));
+                break;
+            case 6: {
+                auto node = map.extract(key);
+                REQUIRE_EQ(expected.count(key) == 1, !node.empty());
+                if (node) {
+                    node.key() = key + 5000;
+                    expected.erase(key);
+                    bool added = expected.emplace(key + 5000, node.data())
+                                     .second;
+                    CHECK_EQ(added, map.insert(std::move(node)).second);
+                }
+                break;
+            }
+            case 7: {
+                auto it = map.find(key);
+                auto found = expected.find(key);
+                REQUIRE_EQ(found != expected.end(), it != map.end());
+                if (found != expected.end()) {
+                    CHECK_EQ(found->second, it->data);
+                }
+                break;
+            }
+            default:
+                CHECK_EQ(expected.count(key) == 1, map.contains(key));
+            }
+            if (step % 5000 == 0) {
+                Hashmap<int, int> copy(map);
+                REQUIRE_EQ(expected.size(), copy.size());
+                CHECK_EQ(expected.size(),
+                         std::distance(copy.begin(), copy.end()));
+            }
+        }
+        REQUIRE_EQ(expected.size(), map.size());
+        for (auto entry : map) {
+            REQUIRE_EQ(expected.at(entry.key), entry.data);
+        }
+        CHECK_EQ(expected.size(), std::distance(map.begin(), map.end()));
+    }
+}
+
+TEST_SUITE("snapshot map") {
+    TEST_CASE("test snapshot map publishes whole versions") {
+        SnapshotHashmap<int, int> map;
+        CHECK_EQ(0, map.size());
+        CHECK_THROWS_AS(map.get(1), key_not_found);
+
+        Hashmap<int, int> first;
+        first.add(1, 10);
+        first.add(2, 20);
+        map.publish(std::move(first));
+        CHECK_EQ(2, map.size());
+        CHECK_EQ(20, map.get(2));
+
+        map.update([](Hashmap<int, int> &next) {
+            next.put(2, 21);
+            next.add(3, 30);
+        });
+        CHECK_EQ(3, map.size());
+        CHECK_EQ(10, map.get(1));
+        CHECK_EQ(21, map.get(2));
+        CHECK(map.contains(3));
+    }
+
+    TEST_CASE("test snapshot keeps its version alive and unchanged") {
+        // what earlier tests retired must not be counted here
+        drain_epochs();
+        gint::init();
+        gimap first;
+        first.add(1, gint(1));
+        SnapshotHashmap<int, gint> map(std::move(first));
+        auto keep = [](gimap &) {};
+        {
+            auto before = map.snapshot();
+            map.update([](gimap &next) {
+                next.put(1, gint(2));
+                next.add(2, gint(3));
+            });
+            map.update(keep);
+            CHECK_EQ(1, before->size());
+            CHECK_EQ(1, before->get(1));
+            CHECK_EQ(2, map.get(1));
+            // the pinned first version and the two after it
+            CHECK_EQ(5, gint::count());
+        }
+        // with no reader left, every publish frees what is two versions old
+        map.update(keep);
+        CHECK_EQ(6, gint::count());
+        map.update(keep);
+        CHECK_EQ(4, gint::count());
+        map.update(keep);
+        CHECK_EQ(4, gint::count());
+    }
+
+    TEST_CASE("test snapshot map drops an update that throws") {
+        Hashmap<int, int> first;
+        first.add(1, 10);
+        SnapshotHashmap<int, int> map(std::move(first));
+        CHECK_THROWS_AS(map.update([](Hashmap<int, int> &next) {
+            next.put(1, 11);
+            next.get(2);
+        }),
+                        key_not_found);
+        CHECK_EQ(10, map.get(1));
+        CHECK_EQ(1, map.size());
+    }
+
+    TEST_CASE("test snapshot readers always see one whole version") {
+        const int count = 200;
+        SnapshotHashmap<int, int> map;
+        std::atomic<bool> done = false;
+        std::atomic<int> wrong = 0;
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 4; ++t) {
+            readers.emplace_back([&] {
+                while (!done) {
+                    auto snapshot = map.snapshot();
+                    // every value of a version is its number of items
+                    for (auto [key, value] : *snapshot) {
+                        if (value != static_cast<int>(snapshot->size())) {
+                            wrong++;
+                        }
+                    }
+                }
+            });
+        }
+        for (int version = 1; version <= count; ++version) {
+            map.update([version](Hashmap<int, int> &next) {
+                next.add(version, 0);
+                for (auto [key, value] : next) {
+                    value = version;
+                }
+            });
+        }
+        done = true;
+        for (std::thread &reader : readers) {
+            reader.join();
+        }
+        CHECK_EQ(0, wrong.load());
+        CHECK_EQ(count, map.size());
+    }
+}
+
+TEST_SUITE("parallel build") {
+    /// @brief a value that throws when made from one chosen number, counted
+    /// atomically since the workers make them side by side
+    struct Picky {
+        static inline int refuse = -1;
+        static inline std::atomic<int> live = 0;
+
+        Picky(int i) {
+            if (i == refuse) {
+                throw std::runtime_error("refused");
+            }
+            live++;
+        }
+        Picky(const Picky &) { live++; }
+        ~Picky() { live--; }
+    };
+
+    TEST_CASE_TEMPLATE("test parallel build matches the range constructor",
+                       Storage, chained_storage<>,
+                       chained_storage<prime_buckets>,
+                       chained_storage<pow2_buckets, true>) {
+        using Map = Hashmap<int, int, hasher<int>, std::equal_to<>, Storage>;
+        std::vector<std::pair<int, int>> items;
+        for (int i = 0; i < 5000; ++i) {
+            // every key shows up twice, the first time with its own value
+            items.push_back({i % 2500, i});
+        }
+        Map serial(items.begin(), items.end());
+        for (unsigned threads : {1u, 2u, 3u, 8u}) {
+            Map built = Map::parallel_build(items, threads);
+            REQUIRE_EQ(2500, built.size());
+            CHECK(built == serial);
+            CHECK_EQ(serial.bucket_count(), built.bucket_count());
+            CHECK_EQ(7, built.get(7));
+            built.remove(7);
+            built.add(5000, 1);
+            CHECK_EQ(2500, built.size());
+        }
+        CHECK_EQ(0, Map::parallel_build(std::vector<std::pair<int, int>>(), 4)
+                        .size());
+        // more threads than items
+        CHECK_EQ(2, Map::parallel_build(
+                        std::vector<std::pair<int, int>>{{1, 1}, {2, 2}}, 16)
+                        .size());
+    }
+
+    TEST_CASE("test parallel build frees what it made when an item throws") {
+        std::vector<std::pair<int, int>> items;
+        for (int i = 0; i < 1000; ++i) {
+            items.push_back({i, i});
+        }
+        Picky::refuse = 700;
+        CHECK_THROWS_AS((Hashmap<int, Picky>::parallel_build(items, 4)),
+                        std::runtime_error);
+        CHECK_EQ(0, Picky::live.load());
+        Picky::refuse = -1;
+        {
+            auto map = Hashmap<int, Picky>::parallel_build(items, 4);
+            CHECK_EQ(1000, Picky::live.load());
+            map.clear();
+            CHECK_EQ(0, Picky::live.load());
+        }
+    }
+
+    TEST_CASE_TEMPLATE("test parallel rehash keeps every item", Storage,
+                       chained_storage<>, chained_storage<prime_buckets>,
+                       chained_storage<pow2_buckets, true>) {
+        using Map = Hashmap<int, gint, hasher<int>, std::equal_to<>, Storage>;
+        gint::init();
+        {
+            Map map;
+            for (int i = 0; i < 3000; ++i) {
+                map.add(i, i);
+            }
+            Map before = map;
+            map.rehash(50000, 4);
+            CHECK_EQ(Storage::bucket_index::bucket_count(50000),
+                     map.bucket_count());
+            CHECK(map == before);
+            // back down to what the items need
+            map.rehash(0, 3);
+            before.rehash(0);
+            CHECK_EQ(before.bucket_count(), map.bucket_count());
+            CHECK(map == before);
+            CHECK_EQ(6000, gint::count());
+        }
+        CHECK_EQ(0, gint::count());
+    }
+
+    /// @brief hashes like hasher<int> until armed, then throws on one key
+    struct FussyHash {
+        static inline std::atomic<bool> armed = false;
+
+        hash_t operator()(int key) const {
+            if (armed && key == 1234) {
+                throw std::runtime_error("fussy");
+            }
+            return hasher<int>()(key);
+        }
+    };
+
+    TEST_CASE("test parallel rehash leaves the map alone when Hash throws") {
+        Hashmap<int, int, FussyHash> map;
+        for (int i = 0; i < 3000; ++i) {
+            map.add(i, i);
+        }
+        size_t buckets = map.bucket_count();
+        FussyHash::armed = true;
+        CHECK_THROWS_AS(map.rehash(50000, 4), std::runtime_error);
+        FussyHash::armed = false;
+        CHECK_EQ(buckets, map.bucket_count());
+        CHECK_EQ(3000, map.size());
+        CHECK_EQ(3000, std::distance(map.begin(), map.end()));
+        for (int i = 0; i < 3000; ++i) {
+            REQUIRE_EQ(i, map.get(i));
+        }
+    }
+
+    TEST_CASE("test parallel build frees what it made when Hash throws") {
+        std::vector<std::pair<int, int>> items;
+        for (int i = 0; i < 3000; ++i) {
+            items.push_back({i, i});
+        }
+        FussyHash::armed = true;
+        CHECK_THROWS_AS((Hashmap<int, Picky, FussyHash>::parallel_build(
+                            items, 4)),
+                        std::runtime_error);
+        FussyHash::armed = false;
+        CHECK_EQ(0, Picky::live.load());
+    }
+
+#ifdef DEBUG
+    TEST_CASE("test parallel rehash takes in a grow left half done") {
+        gimap map;
+        for (int i = 0; i < 17; ++i) {
+            map.add(i, i);
+        }
+        REQUIRE_EQ(16, getOldBucketCount(map));
+        map.rehash(1024, 4);
+        CHECK_EQ(0, getOldBucketCount(map));
+        CHECK_EQ(1024, map.bucket_count());
+        CHECK_EQ(17, map.size());
+        for (int i = 0; i < 17; ++i) {
+            REQUIRE_EQ(i, map.get(i));
+        }
+    }
+#endif
+}
+
+TEST_SUITE("bucket index") {
+    TEST_CASE("test pow2 bucket counts round up") {
+        CHECK_EQ(1, pow2_buckets::bucket_count(1));
+        CHECK_EQ(16, pow2_buckets::bucket_count(16));
+        CHECK_EQ(32, pow2_buckets::bucket_count(17));
+        CHECK_EQ(1024, pow2_buckets::bucket_count(1000));
+    }
+    TEST_CASE("test pow2 index uses every bit of the hash") {
+        pow2_buckets index(16);
+        // these differ only above the mask, without the finalizer they
+        // would all land in bucket 0
+        bool spread = false;
+        for (hash_t i = 1; i < 16; ++i) {
+            REQUIRE_LT(index(i << 40), 16);
+            spread = spread || index(i << 40) != index(0);
+        }
+        CHECK(spread);
+    }
+    TEST_CASE("test prime bucket counts") {
+        CHECK_EQ(17, prime_buckets::bucket_count(16));
+        CHECK_EQ(37, prime_buckets::bucket_count(34));
+        CHECK_EQ(4294967291ULL, prime_buckets::bucket_count(4294967291ULL));
+        CHECK_THROWS_AS(prime_buckets::bucket_count(4294967292ULL),
+                        std::length_error);
+    }
+    TEST_CASE("test prime index matches modulus") {
+        for (size_t count : {17ULL, 1031ULL, 1048583ULL, 4294967291ULL}) {
+            prime_buckets index(count);
+            for (hash_t hval : {0ULL, 1ULL, 16ULL, 17ULL, 123456789ULL,
+                                0xFFFFFFFFULL, 0xDEADBEEFCAFEF00DULL,
+                                ~0ULL}) {
+                uint32_t folded = static_cast<uint32_t>(hval ^ (hval >> 32));
+                REQUIRE_EQ(folded % count, index(hval));
+            }
+        }
+    }
+    TEST_CASE("test prime map grows through primes") {
+        gint::init();
+        gprmap map;
+        CHECK_EQ(17, getBucketCount(map));
+
+        for (int i = 0; i < 18; ++i) {
+            map.add(i, i);
+        }
+        CHECK_EQ(37, getBucketCount(map));
+
+        for (int i = 18; i < 1000; ++i) {
+            map.add(i, i + 1000);
+        }
+        CHECK_EQ(2053, getBucketCount(map));
+        CHECK_EQ(1000, gint::count());
+        for (int i = 18; i < 1000; ++i) {
+            REQUIRE_EQ(i + 1000, map.get(i));
+        }
+        for (int i = 0; i < 990; ++i) {
+            map.remove(i);
+        }
+
+        CHECK(map.optimize());
+        CHECK_EQ(17, getBucketCount(map));
+        for (int i = 990; i < 1000; ++i) {
+            REQUIRE_EQ(i + 1000, map.get(i));
+        }
+    }
+    TEST_CASE("test prime map copy and assign") {
+        gprmap map;
+        for (int i = 0; i < 100; ++i) {
+            map.add(i, i);
+        }
+
+        gprmap copy(map);
+        gprmap assigned;
+        assigned = map;
+
+        CHECK(copy == map);
+        CHECK(assigned == map);
+        CHECK_EQ(getBucketCount(map), getBucketCount(assigned));
+    }
+}
+
+TEST_SUITE("allocators") {
+    TEST_CASE_TEMPLATE("test maps allocate through the allocator", Storage,
+                       chained_storage<>, flat_storage, swiss_storage) {
+        using Map = Hashmap<int, int, hasher<int>, std::equal_to<>, Storage,
+                            CountingAllocator<std::pair<const int, int>>>;
+        {
+            Map map;
+            for (int i = 0; i < 100; ++i) {
+                map.add(i, i);
+            }
+            CHECK_GT(liveBlocks<int, int, Storage>(), 0);
+
+            Map copy(map);
+            Map assigned;
+            assigned = copy;
+            CHECK_EQ(100, assigned.size());
+            Map moved(std::move(copy));
+            for (int i = 0; i < 50; ++i) {
+                moved.remove(i);
+            }
+            CHECK_EQ(50, moved.size());
+        }
+        CHECK_EQ(0, liveBlocks<int, int, Storage>());
+    }
+
+    TEST_CASE("test slab arena reuses freed blocks") {
+        SlabArena arena(4);
+        size_t size = SlabArena::round_size(sizeof(int));
+
+        void *first = arena.allocate(size);
+        void *second = arena.allocate(size);
+        CHECK_NE(first, second);
+        CHECK_EQ(1, arena.slab_count());
+
+        arena.deallocate(first);
+        CHECK_EQ(first, arena.allocate(size));
+
+        for (int i = 0; i < 4; ++i) {
+            arena.allocate(size);
+        }
+        CHECK_EQ(2, arena.slab_count());
+
+        arena.release();
+        CHECK_EQ(0, arena.slab_count());
+    }
+
+    TEST_CASE("test pool allocator map") {
+        gint::init();
+
+        gpmap map;
+        for (int i = 0; i < 1000; ++i) {
+            map.add(i, i + 1000);
+        }
+        for (int i = 0; i < 500; ++i) {
+            REQUIRE_EQ(i + 1000, map.remove(i));
+        }
+
+        CHECK_EQ(500, gint::count());
+        CHECK_GT(map.get_allocator().slab_count(), 0);
+
+        map.clear();
+
+        CHECK_EQ(0, gint::count());
+        CHECK_EQ(0, map.size());
+        CHECK_EQ(0, map.get_allocator().slab_count());
+
+        map.add(1, 9867);
+        CHECK_EQ(9867, map.get(1));
+    }
+    TEST_CASE("test pool allocator clear frees slabs at once") {
+        Hashmap<int, int, hasher<int>, std::equal_to<>, chained_storage<>,
+                PoolAllocator<std::pair<const int, int>>>
+            map;
+        for (int i = 0; i < 10000; ++i) {
+            map.add(i, i);
+        }
+        CHECK_GT(map.get_allocator().slab_count(), 1);
+
+        map.clear();
+
+        CHECK_EQ(0, map.get_allocator().slab_count());
+        CHECK_FALSE(map.contains(1));
+    }
+    TEST_CASE("test pool allocator keeps a one bucket table off the slabs") {
+        using Map =
+            Hashmap<int, int, hasher<int>, std::equal_to<>, chained_storage<>,
+                    PoolAllocator<std::pair<const int, int>>>;
+        Map map(1);
+        REQUIRE_EQ(1, map.bucket_count());
+        CHECK_EQ(0, map.get_allocator().slab_count());
+        for (int i = 0; i < 100; ++i) {
+            map.add(i, i);
+        }
+        // the nodes claimed the slabs, not the buckets
+        CHECK_GT(map.get_allocator().slab_count(), 0);
+        map.clear();
+        CHECK_EQ(0, map.get_allocator().slab_count());
+        for (int i = 0; i < 100; ++i) {
+            map.add(i, i + 1);
+        }
+        CHECK_EQ(42, map.get(41));
+
+        Map empty;
+        empty.rehash(0);
+        empty.clear();
+        empty.add(1, 1);
+        CHECK_EQ(1, empty.get(1));
+        empty.clear();
+        CHECK_EQ(0, empty.size());
+    }
+    TEST_CASE("test pool allocator shared between maps") {
+        gint::init();
+
+        PoolAllocator<std::pair<const int, gint>> pool;
+        {
+            gpmap map(pool);
+            gpmap otherMap(pool);
+            map.add(1, 9867);
+            otherMap.add(2, 9999);
+
+            CHECK(map.get_allocator() == pool);
+
+            map.clear();
+
+            CHECK_EQ(9999, otherMap.get(2));
+            CHECK_EQ(1, gint::count());
+        }
+        CHECK_EQ(0, gint::count());
+    }
+    TEST_CASE("test pool allocator copies get their own arena") {
+        gint::init();
+
+        gpmap map;
+        map.add(1, 9867);
+
+        gpmap copy(map);
+        gpmap moved(std::move(map));
+
+        CHECK(copy.get_allocator() != moved.get_allocator());
+        CHECK_EQ(9867, copy.get(1));
+        CHECK_EQ(9867, moved.get(1));
+        CHECK_EQ(2, gint::count());
+    }
+}
+
+TEST_CASE("test resize with empty map") {
+    gint::init();
+    gimap map;
+
+    #ifndef DEBUG
+    INFO("DEBUG macro not defined");
+    REQUIRE(false);
+    #else
+        forceResize(map);
+    #endif
+
+    CHECK_EQ(0, gint::count());
+    CHECK_EQ(0, map.size());
+}
+TEST_CASE("test resize with non-empty map") {
+    gint::init();
+    gimap map;
+
+    int keys[] = {1, 2, 3, 4};
+    int values[] = {9967, 9999, 1, 2379};
+    for (int i = 0; i < 4; ++i) {
+        map.add(keys[i], values[i]);
+    }
+    
+    #ifndef DEBUG
+    #error "DEBUG macro not defined"
+    REQUIRE(false);
+    #else
+        forceResize(map);
+    #endif
+
+    CHECK_EQ(4, gint::count());
+    CHECK_EQ(4, map.size());
+    CHECK_EQ(9967, map.get(1));
+    CHECK_EQ(9999, map.get(2));
+    CHECK_EQ(1, map.get(3));
+}
+TEST_CASE("test resize relinks nodes without copying values") {
+    gint::init();
+    gimap map;
+    for (int i = 0; i < 100; ++i) {
+        map.add(i, i + 1000);
+    }
+    gint::changes();
+
+    forceResize(map);
+    map.max_load_factor(0.1f);
+
+    auto changes = gint::changes();
+    CHECK_EQ(0, changes.increments);
+    CHECK_EQ(0, changes.decrements);
+    CHECK_EQ(100, gint::count());
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE_EQ(i + 1000, map.get(i));
+    }
+}
+TEST_CASE("test growth on add constructs only the new value") {
+    gint::init();
+    gimap map;
+    gint value = 0;
+    gint::changes();
+
+    for (int i = 0; i < 1000; ++i) {
+        map.add(i, value);
+
+        auto changes = gint::changes();
+        REQUIRE_EQ(1, changes.increments);
+        REQUIRE_EQ(0, changes.decrements);
+    }
+    CHECK_GT(getBucketCount(map), 1000);
 }